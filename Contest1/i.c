@@ -4,6 +4,8 @@
 #include <stdint.h>
 #include <assert.h>
 
+#include "radix64.c.h"
+
 // ---------------------------------------------------------------------------------------------------------------------
 // Const & Define
 // ---------------------------------------------------------------------------------------------------------------------
@@ -61,40 +63,6 @@ int main(void) {
 // Implementation
 // ---------------------------------------------------------------------------------------------------------------------
 
-const int N_STEPS = 64 / 8;
-
 static void radix_sort(uint64_t *const array_orig, uint size) {
-    uint64_t *array = array_orig;
-    uint64_t *buf = calloc(size, sizeof(uint64_t));
-    uint64_t *tmp_ptr;
-    uint counters[257]; // 256 bytes + 1 reserved for simpler logic
-
-    for (int step = 0; step < N_STEPS; ++step) {
-        memset (counters, 0, 257 * sizeof (uint));
-
-        for (uint i = 0; i < size; ++i) {
-            counters[((unsigned char *)(array + i))[step] + 1]++; // +1 => 257 надо
-        }
-
-        assert (counters[0] == 0);
-
-        for (int i = 2; i < 256; ++i) {
-            counters[i] += counters[i-1];
-        }
-
-        for (uint i = 0; i < size; ++i) {
-            buf[counters[((unsigned char *)(array + i))[step]]] = array[i];
-            counters[((unsigned char *)(array + i))[step]]++;
-        }
-
-        tmp_ptr = array;
-        array = buf;
-        buf = tmp_ptr;
-    }
-
-    if (array != array_orig) {
-        memcpy (array_orig, array, sizeof(uint64_t) * size);
-    }
-
-    free(buf);
-}
\ No newline at end of file
+    radix64_sort(array_orig, size, radix64_digit_bits(size));
+}
@@ -0,0 +1,86 @@
+#ifndef ALGO_RADIX64_C_H
+#define ALGO_RADIX64_C_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// ---------------------------------------------------------------------------------------------------------------------
+// LSD radix sort of 64-bit keys
+// ---------------------------------------------------------------------------------------------------------------------
+
+/// Digit width for size keys: wide digits save passes, but their histograms must stay small next to the array
+static unsigned radix64_digit_bits(size_t size) {
+    if (size >= (1u << 21)) {
+        return 16;
+    }
+
+    if (size >= (1u << 16)) {
+        return 11;
+    }
+
+    return 8;
+}
+
+/// Histograms of every pass come from a single read, passes whose digit is the same in all keys are skipped
+static void radix64_sort(uint64_t *const array_orig, size_t size, unsigned digit_bits) {
+    if (size < 2) {
+        return;
+    }
+
+    const unsigned n_passes = (64 + digit_bits - 1) / digit_bits;
+    const size_t base = (size_t) 1 << digit_bits;
+    const uint64_t mask = base - 1;
+
+    uint64_t *array = array_orig;
+    uint64_t *buf = NULL;
+    uint64_t *tmp_ptr;
+    size_t *counters = calloc(n_passes * base, sizeof(size_t));
+
+    for (size_t i = 0; i < size; ++i) {
+        uint64_t key = array[i];
+
+        for (unsigned pass = 0; pass < n_passes; ++pass) {
+            counters[pass * base + ((key >> (pass * digit_bits)) & mask)]++;
+        }
+    }
+
+    for (unsigned pass = 0; pass < n_passes; ++pass) {
+        size_t *counts = counters + pass * base;
+        unsigned shift = pass * digit_bits;
+
+        if (counts[(array[0] >> shift) & mask] == size) {
+            continue;
+        }
+
+        if (buf == NULL) {
+            buf = malloc(size * sizeof(uint64_t));
+        }
+
+        size_t pos = 0;
+
+        for (size_t digit = 0; digit < base; ++digit) {
+            size_t count = counts[digit];
+            counts[digit] = pos;
+            pos += count;
+        }
+
+        for (size_t i = 0; i < size; ++i) {
+            buf[counts[(array[i] >> shift) & mask]++] = array[i];
+        }
+
+        tmp_ptr = array;
+        array = buf;
+        buf = tmp_ptr;
+    }
+
+    if (array != array_orig) {
+        memcpy (array_orig, array, sizeof(uint64_t) * size);
+        buf = array;
+    }
+
+    free(buf);
+    free(counters);
+}
+
+#endif
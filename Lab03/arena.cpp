@@ -0,0 +1,173 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include "sorts.h"
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+// Smallest block, so a run of tiny sorts doesn't allocate one block each
+const size_t SORT_ARENA_MIN_BLOCK = 64 * 1024;
+// Transparent huge page size on x86-64 / arm64 Linux
+const size_t SORT_ARENA_HUGE_PAGE = 2 * 1024 * 1024;
+// Scratch kept by the thread-local arena between sorts
+const size_t SORT_ARENA_LOCAL_KEEP = 64 * 1024 * 1024;
+
+/// Header at the start of every block, the data follows at SORT_ARENA_HEADER
+struct sort_arena_block_t {
+    sort_arena_block_t *prev;
+    size_t capacity;
+    size_t used;
+    bool mapped;
+};
+
+const size_t SORT_ARENA_HEADER = (sizeof(sort_arena_block_t) + SORT_ARENA_ALIGN - 1) & ~(SORT_ARENA_ALIGN - 1);
+
+static sort_arena_block_t *block_new (size_t capacity, bool huge_pages);
+static void block_free (sort_arena_block_t *block);
+static inline size_t round_up (size_t size, size_t align);
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Scratch arena
+// ---------------------------------------------------------------------------------------------------------------------
+
+void sort_arena_init (sort_arena_t *arena, bool huge_pages) {
+    arena->top = NULL;
+    arena->in_use = 0;
+    arena->peak = 0;
+    arena->keep_limit = SIZE_MAX;
+    arena->huge_pages = huge_pages;
+}
+
+void sort_arena_free (sort_arena_t *arena) {
+    while (arena->top != NULL) {
+        sort_arena_block_t *block = arena->top;
+        arena->top = block->prev;
+        block_free(block);
+    }
+
+    arena->in_use = 0;
+    arena->peak = 0;
+}
+
+sort_arena_t *sort_arena_local () {
+    struct local_arena_t {
+        sort_arena_t arena;
+
+        local_arena_t () {
+            sort_arena_init(&arena, false);
+            arena.keep_limit = SORT_ARENA_LOCAL_KEEP;
+        }
+
+        ~local_arena_t () {
+            sort_arena_free(&arena);
+        }
+    };
+
+    static thread_local local_arena_t local;
+    return &local.arena;
+}
+
+/// A full block is left as is and a larger one is stacked on it, so earlier pointers stay valid
+void *sort_arena_alloc (sort_arena_t *arena, size_t size) {
+    size = round_up((size > 0) ? size : 1, SORT_ARENA_ALIGN);
+    sort_arena_block_t *top = arena->top;
+
+    if (top == NULL || top->capacity - top->used < size) {
+        size_t capacity = (top != NULL) ? 2 * top->capacity : SORT_ARENA_MIN_BLOCK;
+        capacity = (capacity > arena->peak) ? capacity : arena->peak;
+        capacity = (capacity > size) ? capacity : size;
+
+        top = block_new(capacity, arena->huge_pages);
+        top->prev = arena->top;
+        arena->top = top;
+    }
+
+    void *ptr = (char *) top + SORT_ARENA_HEADER + top->used;
+    top->used += size;
+    arena->in_use += size;
+    arena->peak = (arena->in_use > arena->peak) ? arena->in_use : arena->peak;
+
+    return ptr;
+}
+
+sort_arena_mark_t sort_arena_mark (const sort_arena_t *arena) {
+    return {arena->top, (arena->top != NULL) ? arena->top->used : 0, arena->in_use};
+}
+
+/// Releasing to an empty arena keeps a single block, when it can hold the peak and is within keep_limit
+void sort_arena_release (sort_arena_t *arena, sort_arena_mark_t mark) {
+    bool emptied = (mark.in_use == 0);
+
+    while (arena->top != NULL && (emptied || arena->top != mark.block)) {
+        sort_arena_block_t *block = arena->top;
+
+        if (emptied && block->prev == NULL && block->capacity >= arena->peak && block->capacity <= arena->keep_limit) {
+            break;
+        }
+
+        arena->top = block->prev;
+        block_free(block);
+    }
+
+    if (arena->top != NULL) {
+        arena->top->used = emptied ? 0 : mark.used;
+    }
+
+    arena->in_use = mark.in_use;
+
+    // Otherwise the next sort would grow an oversized block again
+    if (emptied && arena->top == NULL && arena->peak > arena->keep_limit) {
+        arena->peak = 0;
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+// lib functions
+// ---------------------------------------------------------------------------------------------------------------------
+
+static sort_arena_block_t *block_new (size_t capacity, bool huge_pages) {
+    sort_arena_block_t *block = NULL;
+    size_t size = SORT_ARENA_HEADER + capacity;
+    bool mapped = false;
+
+#ifdef __linux__
+    if (huge_pages && size >= SORT_ARENA_HUGE_PAGE) {
+        size = round_up(size, SORT_ARENA_HUGE_PAGE);
+        void *ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+        if (ptr != MAP_FAILED) {
+            madvise(ptr, size, MADV_HUGEPAGE);
+            block = (sort_arena_block_t *) ptr;
+            mapped = true;
+        }
+    }
+#endif
+
+    if (block == NULL) {
+        size = round_up(size, SORT_ARENA_ALIGN);
+        block = (sort_arena_block_t *) aligned_alloc(SORT_ARENA_ALIGN, size);
+    }
+
+    block->prev = NULL;
+    block->capacity = size - SORT_ARENA_HEADER;
+    block->used = 0;
+    block->mapped = mapped;
+
+    return block;
+}
+
+static void block_free (sort_arena_block_t *block) {
+#ifdef __linux__
+    if (block->mapped) {
+        munmap(block, SORT_ARENA_HEADER + block->capacity);
+        return;
+    }
+#endif
+
+    free(block);
+}
+
+static inline size_t round_up (size_t size, size_t align) {
+    return (size + align - 1) / align * align;
+}
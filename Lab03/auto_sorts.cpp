@@ -0,0 +1,56 @@
+#include "sorts.h"
+#include "sort_auto_calibration.h"
+
+// Inputs this short go straight to introsort, a wrong pick costs less than the sample
+const size_t SORT_AUTO_SMALL_SIZE = 4 * SORT_NETWORK_MAX_SIZE;
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Automatic dispatch
+// ---------------------------------------------------------------------------------------------------------------------
+
+void sort_auto (int *array, size_t len) {
+    sort_auto(array, len, SORT_AUTO_CALIBRATION);
+}
+
+void sort_auto (int *array, size_t len, const sort_auto_calibration_t &calibration) {
+    sort_auto(array, len, calibration, sort_arena_local());
+}
+
+/// Counts direction turns rather than descents, so runs in mixed directions (organ pipe, sawtooth) count as presorted
+bool sort_auto_presorted (const sample_stats_t &stats, const sort_auto_calibration_t &calibration) {
+    return (double) stats.turns <= calibration.presorted_max_ratio * (double) stats.size;
+}
+
+/// Structure exploiting sorts are tried first, radix and introsort are left for inputs without any
+void sort_auto (int *array, size_t len, const sort_auto_calibration_t &calibration, sort_arena_t *arena) {
+    if (len < SORT_AUTO_SMALL_SIZE) {
+        qsort_simd(array, len);
+        return;
+    }
+
+    // The ratio is calibrated at one size, the cap keeps the count table cache sized at any other
+    size_t counting_range = (size_t) (calibration.counting_range_ratio * (double) len);
+    counting_range = (counting_range < COUNTING_SORT_MAX_RANGE) ? counting_range : COUNTING_SORT_MAX_RANGE;
+
+    if (counting_range > 0 && counting_sort_try(array, len, counting_range, arena)) {
+        return;
+    }
+
+    sample_stats_t stats = sample_stats(array, len);
+
+    if (sort_auto_presorted(stats, calibration)) {
+        powersort(array, len, arena);
+        return;
+    }
+
+    if ((double) stats.distinct <= calibration.duplicate_max_ratio * (double) stats.size) {
+        qsort_dual_pivot(array, len);
+        return;
+    }
+
+    if (len >= calibration.radix_min_size && len < calibration.radix_max_size) {
+        radix_sort(array, len, arena);
+    } else {
+        qsort_simd(array, len);
+    }
+}
@@ -0,0 +1,624 @@
+#ifndef ALGO_GENERIC_SORTS_H
+#define ALGO_GENERIC_SORTS_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+#include <type_traits>
+#include "sorts.h"
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Compile-time sort API: sort<Algorithm, PivotPolicy>(array, len, comp)
+//
+// Every algorithm is specialised for the key type, the comparator and the pivot policy, nothing is called indirectly
+// ---------------------------------------------------------------------------------------------------------------------
+
+// Slices this small are finished by sort_small
+const size_t SORT_SMALL_SIZE = 16;
+// Same for the dual-pivot quicksort, whose partitioning step is more expensive
+const size_t DUAL_PIVOT_SMALL_SIZE = 32;
+// Below these lengths the ninther and the sqrt(len) sample fall back to the median of three
+const size_t NINTHER_MIN_SIZE = 128;
+const size_t SQRT_SAMPLE_MIN_SIZE = 1024;
+
+/// Default comparator
+struct less_t {
+    template <typename T>
+    bool operator() (const T &lhs, const T &rhs) const {
+        return lhs < rhs;
+    }
+};
+
+template <typename T>
+inline void sort_swap (T *array, size_t i, size_t j) {
+    T tmp    = array[i];
+    array[i] = array[j];
+    array[j] = tmp;
+}
+
+inline unsigned int sort_log2_floor (size_t value) {
+    unsigned int log = 0;
+
+    while (value > 1) {
+        value >>= 1;
+        log++;
+    }
+
+    return log;
+}
+
+/// Stable insertion sort
+template <typename T, typename Compare>
+inline void sort_insertion (T *array, size_t len, Compare &comp) {
+    for (size_t i = 1; i < len; ++i) {
+        size_t j = i;
+        T insert_val = array[i];
+
+        while (j > 0 && comp(insert_val, array[j-1])) {
+            array[j] = array[j-1];
+            j--;
+        }
+
+        array[j] = insert_val;
+    }
+}
+
+template <typename T, typename Compare>
+inline void sort_small (T *array, size_t len, Compare &comp) {
+    sort_insertion(array, len, comp);
+}
+
+/// Plain ints in ascending order go through the sorting network, equal ints cannot be told apart anyway
+inline void sort_small (int *array, size_t len, less_t &) {
+    sort_network(array, len);
+}
+
+/// xorshift64 with a state per thread, unlike rand() it takes no lock
+inline uint64_t sort_xorshift () {
+    static thread_local uint64_t state = 0x9E3779B97F4A7C15ull ^ (uint64_t) (uintptr_t) &state;
+
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+
+    return state;
+}
+
+template <typename T, typename Compare>
+inline size_t sort_median3 (const T *array, size_t a, size_t b, size_t c, Compare &comp) {
+    if (comp(array[b], array[a])) {
+        size_t tmp = a; a = b; b = tmp;
+    }
+    if (comp(array[c], array[b])) {
+        b = comp(array[c], array[a]) ? a : c;
+    }
+
+    return b;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Pivot policies: static size_t choose (T *array, size_t len, Compare &comp), may reorder array
+// ---------------------------------------------------------------------------------------------------------------------
+
+/// Median of the first, middle and last elements
+struct pivot_median_t {
+    template <typename T, typename Compare>
+    static size_t choose (const T *array, size_t len, Compare &comp) {
+        return sort_median3(array, 0, len / 2, len - 1, comp);
+    }
+};
+
+struct pivot_central_t {
+    template <typename T, typename Compare>
+    static size_t choose (const T *, size_t len, Compare &) {
+        return len / 2;
+    }
+};
+
+struct pivot_random_t {
+    template <typename T, typename Compare>
+    static size_t choose (const T *, size_t len, Compare &) {
+        return rand() % len;
+    }
+};
+
+struct pivot_xorshift_t {
+    template <typename T, typename Compare>
+    static size_t choose (const T *, size_t len, Compare &) {
+        return sort_xorshift() % len;
+    }
+};
+
+/// Tukey's ninther: median of the medians of three evenly spaced triples
+struct pivot_ninther_t {
+    template <typename T, typename Compare>
+    static size_t choose (const T *array, size_t len, Compare &comp) {
+        if (len < NINTHER_MIN_SIZE) {
+            return sort_median3(array, 0, len / 2, len - 1, comp);
+        }
+
+        size_t step = len / 8;
+
+        size_t a = sort_median3(array, 0, step, 2 * step, comp);
+        size_t b = sort_median3(array, 3 * step, 4 * step, 5 * step, comp);
+        size_t c = sort_median3(array, 6 * step, 7 * step, len - 1, comp);
+
+        return sort_median3(array, a, b, c, comp);
+    }
+};
+
+/// Median of an evenly spaced sample of sqrt(len) elements, which are gathered at the front and sorted there
+struct pivot_sqrt_sample_t {
+    template <typename T, typename Compare>
+    static size_t choose (T *array, size_t len, Compare &comp);
+};
+
+/// Median of medians of 5 (BFPRT): a guaranteed 30/70 split, so quicksort stays O(len log len) without luck
+struct pivot_median_of_medians_t {
+    template <typename T, typename Compare>
+    static size_t choose (T *array, size_t len, Compare &comp) {
+        if (len <= 5) {
+            sort_insertion(array, len, comp);
+            return len / 2;
+        }
+
+        size_t n_groups = len / 5;
+
+        for (size_t group = 0; group < n_groups; ++group) {
+            T *five = array + 5 * group;
+            sort_insertion(five, 5, comp);
+            sort_swap(array, group, 5 * group + 2);
+        }
+
+        return select(array, n_groups, n_groups / 2, comp);
+    }
+
+    /// Position of the k-th smallest element after array is rearranged around it
+    template <typename T, typename Compare>
+    static size_t select (T *array, size_t len, size_t k, Compare &comp);
+};
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Algorithms: static void run<PivotPolicy> (T *array, size_t len, Compare &comp)
+// ---------------------------------------------------------------------------------------------------------------------
+
+struct insertion_sort_t {
+    template <typename PivotPolicy, typename T, typename Compare>
+    static void run (T *array, size_t len, Compare &comp) {
+        sort_insertion(array, len, comp);
+    }
+};
+
+struct heap_sort_t {
+    template <typename PivotPolicy, typename T, typename Compare>
+    static void run (T *array, size_t len, Compare &comp) {
+        for (size_t i = len / 2; i > 0; --i) {
+            sift_down(array, len, i - 1, comp);
+        }
+
+        for (size_t end = len; end > 1; --end) {
+            sort_swap(array, 0, end - 1);
+            sift_down(array, end - 1, 0, comp);
+        }
+    }
+
+    template <typename T, typename Compare>
+    static void sift_down (T *array, size_t len, size_t indx, Compare &comp) {
+        T val = array[indx];
+
+        while (2 * indx + 1 < len) {
+            size_t max_child = 2 * indx + 1;
+
+            if (max_child + 1 < len && comp(array[max_child], array[max_child + 1])) {
+                max_child++;
+            }
+
+            if (!comp(val, array[max_child])) {
+                break;
+            }
+
+            array[indx] = array[max_child];
+            indx = max_child;
+        }
+
+        array[indx] = val;
+    }
+};
+
+/// Introsort: fat-pivot partitioning, heapsort once depth exceeds 2*log2(len)
+struct quick_sort_t {
+    template <typename PivotPolicy, typename T, typename Compare>
+    static void run (T *array, size_t len, Compare &comp) {
+        loop<PivotPolicy>(array, len, comp, 2 * sort_log2_floor(len));
+    }
+
+    /// Recurses into the smaller side and loops on the larger one, so stack depth is O(log len)
+    template <typename PivotPolicy, typename T, typename Compare>
+    static void loop (T *array, size_t len, Compare &comp, unsigned int depth_limit) {
+        while (len > SORT_SMALL_SIZE) {
+            if (depth_limit == 0) {
+                heap_sort_t::run<PivotPolicy>(array, len, comp);
+                return;
+            }
+
+            depth_limit--;
+
+            size_t lt_end = 0;
+            size_t gt_start = 0;
+            partition_three_way(array, len, PivotPolicy::choose(array, len, comp), comp, &lt_end, &gt_start);
+
+            size_t right_len = len - gt_start;
+
+            if (lt_end < right_len) {
+                loop<PivotPolicy>(array, lt_end, comp, depth_limit);
+
+                array += gt_start;
+                len = right_len;
+            } else {
+                loop<PivotPolicy>(array + gt_start, right_len, comp, depth_limit);
+
+                len = lt_end;
+            }
+        }
+
+        sort_small(array, len, comp);
+    }
+
+    /// Dutch national flag: [0, lt_end) < pivot, [lt_end, gt_start) == pivot, [gt_start, len) > pivot
+    template <typename T, typename Compare>
+    static void partition_three_way (T *array, size_t len, size_t pivot_pos, Compare &comp,
+                                     size_t *lt_end, size_t *gt_start) {
+        T pivot = array[pivot_pos];
+
+        size_t lt = 0;
+        size_t i  = 0;
+        size_t gt = len;
+
+        while (i < gt) {
+            if (comp(array[i], pivot)) {
+                sort_swap(array, lt, i);
+                lt++;
+                i++;
+            } else if (comp(pivot, array[i])) {
+                gt--;
+                sort_swap(array, i, gt);
+            } else {
+                i++;
+            }
+        }
+
+        *lt_end = lt;
+        *gt_start = gt;
+    }
+};
+
+/// Yaroslavskiy dual-pivot quicksort: pivots are the 2nd and 4th of a sorted 5-element sample, one scan splits 3 ways
+struct dual_pivot_quick_sort_t {
+    template <typename PivotPolicy, typename T, typename Compare>
+    static void run (T *array, size_t len, Compare &comp) {
+        loop(array, len, comp, 2 * sort_log2_floor(len));
+    }
+
+    template <typename T, typename Compare>
+    static void loop (T *array, size_t len, Compare &comp, unsigned int depth_limit) {
+        while (len > DUAL_PIVOT_SMALL_SIZE) {
+            if (depth_limit == 0) {
+                heap_sort_t::run<pivot_median_t>(array, len, comp);
+                return;
+            }
+
+            depth_limit--;
+
+            size_t seventh = len / 7;
+            size_t mid = len / 2;
+            size_t sample[5] = {mid - 2 * seventh, mid - seventh, mid, mid + seventh, mid + 2 * seventh};
+
+            for (size_t i = 1; i < 5; ++i) {
+                T val = array[sample[i]];
+                size_t j = i;
+
+                while (j > 0 && comp(val, array[sample[j-1]])) {
+                    array[sample[j]] = array[sample[j-1]];
+                    j--;
+                }
+
+                array[sample[j]] = val;
+            }
+
+            // Equal pivots mean many duplicates: a fat single-pivot partition takes all of them out at once
+            if (!comp(array[sample[1]], array[sample[3]])) {
+                size_t lt_end = 0;
+                size_t gt_start = 0;
+                quick_sort_t::partition_three_way(array, len, sample[2], comp, &lt_end, &gt_start);
+
+                loop(array, lt_end, comp, depth_limit);
+
+                array += gt_start;
+                len -= gt_start;
+                continue;
+            }
+
+            size_t p1_pos = 0;
+            size_t p2_pos = 0;
+            partition_dual(array, len, sample[1], sample[3], comp, &p1_pos, &p2_pos);
+
+            loop(array, p1_pos, comp, depth_limit);
+            loop(array + p1_pos + 1, p2_pos - p1_pos - 1, comp, depth_limit);
+
+            array += p2_pos + 1;
+            len -= p2_pos + 1;
+        }
+
+        sort_small(array, len, comp);
+    }
+
+    /// [0, p1_pos) < p1 <= (p1_pos, p2_pos) <= p2 < (p2_pos, len), pivots must compare strictly less
+    template <typename T, typename Compare>
+    static void partition_dual (T *array, size_t len, size_t p1_sample, size_t p2_sample, Compare &comp,
+                                size_t *p1_pos, size_t *p2_pos) {
+        sort_swap(array, 0, p1_sample);
+        sort_swap(array, len - 1, p2_sample);
+
+        T p1 = array[0];
+        T p2 = array[len - 1];
+
+        size_t less  = 1;
+        size_t great = len - 2;
+
+        while (comp(array[less], p1)) {
+            less++;
+        }
+        while (comp(p2, array[great])) {
+            great--;
+        }
+
+        bool scanned = false;
+
+        for (size_t k = less; k <= great; ++k) {
+            T val = array[k];
+
+            if (comp(val, p1)) {
+                array[k] = array[less];
+                array[less] = val;
+                less++;
+            } else if (comp(p2, val)) {
+                while (comp(p2, array[great])) {
+                    if (great-- == k) {
+                        scanned = true;
+                        break;
+                    }
+                }
+
+                if (scanned) {
+                    break;
+                }
+
+                if (comp(array[great], p1)) {
+                    array[k] = array[less];
+                    array[less] = array[great];
+                    less++;
+                } else {
+                    array[k] = array[great];
+                }
+
+                array[great] = val;
+                great--;
+            }
+        }
+
+        array[0] = array[less - 1];
+        array[less - 1] = p1;
+        array[len - 1] = array[great + 1];
+        array[great + 1] = p2;
+
+        *p1_pos = less - 1;
+        *p2_pos = great + 1;
+    }
+};
+
+/// Stable top-down merge sort, levels alternate between array and a len-sized buffer
+struct merge_sort_t {
+    template <typename PivotPolicy, typename T, typename Compare>
+    static void run (T *array, size_t len, Compare &comp) {
+        run<PivotPolicy>(array, len, comp, sort_arena_local());
+    }
+
+    template <typename PivotPolicy, typename T, typename Compare>
+    static void run (T *array, size_t len, Compare &comp, sort_arena_t *arena) {
+        static_assert(std::is_trivially_copyable<T>::value, "the merge buffer is raw memory");
+
+        if (len < 2) {
+            return;
+        }
+
+        sort_arena_mark_t mark = sort_arena_mark(arena);
+        rec(array, sort_arena_array<T>(arena, len), len, false, comp);
+        sort_arena_release(arena, mark);
+    }
+
+    template <typename T, typename Compare>
+    static void rec (T *array, T *buf, size_t len, bool result_in_buf, Compare &comp) {
+        if (len <= SORT_SMALL_SIZE) {
+            sort_small(array, len, comp);
+
+            if (result_in_buf) {
+                for (size_t i = 0; i < len; ++i) {
+                    buf[i] = array[i];
+                }
+            }
+
+            return;
+        }
+
+        size_t half = len/2;
+        rec(array, buf, half, !result_in_buf, comp);
+        rec(array + half, buf + half, len - half, !result_in_buf, comp);
+
+        if (result_in_buf) {
+            merge(array, array + half, half, len - half, buf, comp);
+        } else {
+            merge(buf, buf + half, half, len - half, array, comp);
+        }
+    }
+
+    template <typename T, typename Compare>
+    static void merge (const T *left, const T *right, size_t left_len, size_t right_len, T *buf, Compare &comp) {
+        size_t i = 0, j = 0;
+
+        while (i < left_len && j < right_len) {
+            if (comp(right[j], left[i])) {
+                *buf++ = right[j++];
+            } else {
+                *buf++ = left[i++];
+            }
+        }
+
+        while (i < left_len) {
+            *buf++ = left[i++];
+        }
+
+        while (j < right_len) {
+            *buf++ = right[j++];
+        }
+    }
+};
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+template <typename T, typename Compare>
+size_t pivot_sqrt_sample_t::choose (T *array, size_t len, Compare &comp) {
+    if (len < SQRT_SAMPLE_MIN_SIZE) {
+        return sort_median3(array, 0, len / 2, len - 1, comp);
+    }
+
+    size_t size = (size_t) sqrt((double) len) | 1;
+
+    for (size_t i = 0; i < size; ++i) {
+        sort_swap(array, i, i * (len / size));
+    }
+
+    quick_sort_t::loop<pivot_median_t>(array, size, comp, 2 * sort_log2_floor(size));
+    return size / 2;
+}
+
+template <typename T, typename Compare>
+size_t pivot_median_of_medians_t::select (T *array, size_t len, size_t k, Compare &comp) {
+    size_t offset = 0;
+
+    while (len > 5) {
+        size_t lt_end = 0;
+        size_t gt_start = 0;
+        quick_sort_t::partition_three_way(array, len, choose(array, len, comp), comp, &lt_end, &gt_start);
+
+        if (k < lt_end) {
+            len = lt_end;
+        } else if (k >= gt_start) {
+            array += gt_start;
+            offset += gt_start;
+            k -= gt_start;
+            len -= gt_start;
+        } else {
+            return offset + k;
+        }
+    }
+
+    sort_insertion(array, len, comp);
+    return offset + k;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+template <typename Algorithm, typename PivotPolicy = pivot_median_t, typename T, typename Compare = less_t>
+inline void sort (T *array, size_t len, Compare comp = Compare()) {
+    Algorithm::template run<PivotPolicy>(array, len, comp);
+}
+
+/// Scratch from arena instead of sort_arena_local(), for the algorithms that need any (merge_sort_t)
+template <typename Algorithm, typename PivotPolicy = pivot_median_t, typename T, typename Compare = less_t>
+inline void sort (T *array, size_t len, sort_arena_t *arena, Compare comp = Compare()) {
+    Algorithm::template run<PivotPolicy>(array, len, comp, arena);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Selection
+// ---------------------------------------------------------------------------------------------------------------------
+
+/// Introselect: puts the k-th smallest at array[k] with smaller elements before it and larger ones after it.
+/// Quickselect with PivotPolicy, median of medians once 2*log2(len) partitions have not found k, so O(len) always
+template <typename PivotPolicy = pivot_median_t, typename T, typename Compare = less_t>
+inline void sort_select_kth (T *array, size_t len, size_t k, Compare comp = Compare()) {
+    unsigned int depth_limit = 2 * sort_log2_floor(len);
+
+    while (len > SORT_SMALL_SIZE) {
+        if (depth_limit == 0) {
+            pivot_median_of_medians_t::select(array, len, k, comp);
+            return;
+        }
+
+        depth_limit--;
+
+        size_t lt_end = 0;
+        size_t gt_start = 0;
+        quick_sort_t::partition_three_way(array, len, PivotPolicy::choose(array, len, comp), comp, &lt_end, &gt_start);
+
+        if (k < lt_end) {
+            len = lt_end;
+        } else if (k >= gt_start) {
+            array += gt_start;
+            k -= gt_start;
+            len -= gt_start;
+        } else {
+            return;
+        }
+    }
+
+    sort_insertion(array, len, comp);
+}
+
+/// Sorts the k smallest elements into array[0, k), the rest is left in no particular order
+template <typename PivotPolicy = pivot_median_t, typename T, typename Compare = less_t>
+inline void sort_partial (T *array, size_t len, size_t k, Compare comp = Compare()) {
+    if (k == 0) {
+        return;
+    }
+
+    if (k < len) {
+        sort_select_kth<PivotPolicy>(array, len, k - 1, comp);
+    } else {
+        k = len;
+    }
+
+    quick_sort_t::run<PivotPolicy>(array, k, comp);
+}
+
+/// Copies the k smallest elements into out in ascending order through a k-sized max-heap, array is only read
+template <typename T, typename Compare = less_t>
+inline void sort_top_k (const T *array, size_t len, size_t k, T *out, Compare comp = Compare()) {
+    k = (k < len) ? k : len;
+
+    if (k == 0) {
+        return;
+    }
+
+    for (size_t i = 0; i < k; ++i) {
+        out[i] = array[i];
+    }
+
+    for (size_t i = k / 2; i > 0; --i) {
+        heap_sort_t::sift_down(out, k, i - 1, comp);
+    }
+
+    for (size_t i = k; i < len; ++i) {
+        if (comp(array[i], out[0])) {
+            out[0] = array[i];
+            heap_sort_t::sift_down(out, k, 0, comp);
+        }
+    }
+
+    for (size_t end = k; end > 1; --end) {
+        sort_swap(out, 0, end - 1);
+        heap_sort_t::sift_down(out, end - 1, 0, comp);
+    }
+}
+
+#endif //ALGO_GENERIC_SORTS_H
@@ -0,0 +1,162 @@
+#include <assert.h>
+#include <string.h>
+#include <stdint.h>
+#include "sorts.h"
+#include "generic_sorts.h"
+
+template <typename Sort>
+static void sort_kv_packed (int *keys, uint32_t *values, size_t len, sort_arena_t *arena, Sort sort);
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Key-value sorts
+// ---------------------------------------------------------------------------------------------------------------------
+
+void radix_sort_kv (int *keys, uint32_t *values, size_t len) {
+    radix_sort_kv(keys, values, len, sort_arena_local());
+}
+
+/// LSD radix sort moving both arrays, passes with the same digit in every key are skipped
+void radix_sort_kv (int *const keys_orig, uint32_t *const values_orig, size_t len, sort_arena_t *arena) {
+    if (len < 2) {
+        return;
+    }
+
+    sort_arena_mark_t mark = sort_arena_mark(arena);
+    int *keys = keys_orig;
+    uint32_t *values = values_orig;
+    int *key_buf = sort_arena_array<int>(arena, len);
+    uint32_t *value_buf = sort_arena_array<uint32_t>(arena, len);
+    size_t counters[sizeof(int)][RADIX_BASE] = {};
+
+    for (size_t i = 0; i < len; ++i) {
+        for (unsigned int step = 0; step < sizeof(int); ++step) {
+            counters[step][radix_digit(keys[i], step)]++;
+        }
+    }
+
+    for (unsigned int step = 0; step < sizeof(int); ++step) {
+        size_t *counts = counters[step];
+
+        if (counts[radix_digit(keys[0], step)] == len) {
+            continue;
+        }
+
+        size_t pos = 0;
+
+        for (unsigned int digit = 0; digit < RADIX_BASE; ++digit) {
+            size_t count = counts[digit];
+            counts[digit] = pos;
+            pos += count;
+        }
+
+        for (size_t i = 0; i < len; ++i) {
+            size_t dst = counts[radix_digit(keys[i], step)]++;
+            key_buf[dst] = keys[i];
+            value_buf[dst] = values[i];
+        }
+
+        int *tmp_keys = keys;
+        keys = key_buf;
+        key_buf = tmp_keys;
+
+        uint32_t *tmp_values = values;
+        values = value_buf;
+        value_buf = tmp_values;
+    }
+
+    if (keys != keys_orig) {
+        memcpy(keys_orig, keys, len * sizeof(int));
+        memcpy(values_orig, values, len * sizeof(uint32_t));
+    }
+
+    sort_arena_release(arena, mark);
+}
+
+void merge_sort_kv (int *keys, uint32_t *values, size_t len) {
+    merge_sort_kv(keys, values, len, sort_arena_local());
+}
+
+void merge_sort_kv (int *keys, uint32_t *values, size_t len, sort_arena_t *arena) {
+    sort_kv_packed(keys, values, len, arena, [arena] (int64_t *items, size_t len) {
+        merge_sort_packed(items, len, arena);
+    });
+}
+
+void qsort_kv (int *keys, uint32_t *values, size_t len) {
+    qsort_kv(keys, values, len, sort_arena_local());
+}
+
+void qsort_kv (int *keys, uint32_t *values, size_t len, sort_arena_t *arena) {
+    sort_kv_packed(keys, values, len, arena, qsort_packed);
+}
+
+void argsort (const int *keys, size_t len, uint32_t *indices) {
+    argsort(keys, len, indices, sort_arena_local());
+}
+
+void argsort (const int *keys, size_t len, uint32_t *indices, sort_arena_t *arena) {
+    assert(len <= UINT32_MAX);
+
+    sort_arena_mark_t mark = sort_arena_mark(arena);
+    int *keys_copy = sort_arena_array<int>(arena, len);
+    memcpy(keys_copy, keys, len * sizeof(int));
+
+    for (size_t i = 0; i < len; ++i) {
+        indices[i] = (uint32_t) i;
+    }
+
+    radix_sort_kv(keys_copy, indices, len, arena);
+
+    sort_arena_release(arena, mark);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void radix_sort_packed (int64_t *items, size_t len) {
+    radix_sort(items, len);
+}
+
+void radix_sort_packed (int64_t *items, size_t len, sort_arena_t *arena) {
+    radix_sort(items, len, arena);
+}
+
+void merge_sort_packed (int64_t *items, size_t len) {
+    merge_sort_packed(items, len, sort_arena_local());
+}
+
+void merge_sort_packed (int64_t *items, size_t len, sort_arena_t *arena) {
+    sort<merge_sort_t>(items, len, arena);
+}
+
+void qsort_packed (int64_t *items, size_t len) {
+    sort<quick_sort_t>(items, len);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+// lib functions
+// ---------------------------------------------------------------------------------------------------------------------
+
+/// Sorts (key, position) pairs and gathers values afterwards, so equal keys keep their order
+template <typename Sort>
+static void sort_kv_packed (int *keys, uint32_t *values, size_t len, sort_arena_t *arena, Sort sort) {
+    assert(len <= UINT32_MAX);
+
+    sort_arena_mark_t mark = sort_arena_mark(arena);
+    int64_t *items = sort_arena_array<int64_t>(arena, len);
+    uint32_t *values_copy = sort_arena_array<uint32_t>(arena, len);
+
+    for (size_t i = 0; i < len; ++i) {
+        items[i] = pack_key_index(keys[i], (uint32_t) i);
+    }
+
+    memcpy(values_copy, values, len * sizeof(uint32_t));
+
+    sort(items, len);
+
+    for (size_t i = 0; i < len; ++i) {
+        keys[i] = packed_key(items[i]);
+        values[i] = values_copy[packed_index(items[i])];
+    }
+
+    sort_arena_release(arena, mark);
+}
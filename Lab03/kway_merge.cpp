@@ -0,0 +1,113 @@
+#include <assert.h>
+#include <stdint.h>
+#include "sorts.h"
+
+// Key bit layout: exhausted flag on top, then the value with its sign flipped, then the run index
+const unsigned int LOSER_KEY_RUN_BITS = 31;
+const uint64_t LOSER_KEY_RUN_MASK = ((uint64_t) 1 << LOSER_KEY_RUN_BITS) - 1;
+const uint64_t LOSER_KEY_EXHAUSTED = (uint64_t) 1 << 63;
+
+static inline uint64_t leaf_key (const loser_tree_t *tree, uint32_t leaf);
+
+// ---------------------------------------------------------------------------------------------------------------------
+// K-way merge
+// ---------------------------------------------------------------------------------------------------------------------
+
+/// Matches are played bottom-up once, after that only the winner's path is replayed
+void loser_tree_init (loser_tree_t *tree, const int *const *runs, const size_t *run_lens, size_t k, sort_arena_t *arena) {
+    assert(k < ((size_t) 1 << LOSER_KEY_RUN_BITS));
+
+    size_t n_leaves = 1;
+
+    while (n_leaves < k) {
+        n_leaves *= 2;
+    }
+
+    tree->arena = arena;
+    tree->mark = sort_arena_mark(arena);
+    tree->heads = sort_arena_array<const int *>(arena, n_leaves);
+    tree->ends = sort_arena_array<const int *>(arena, n_leaves);
+    tree->keys = sort_arena_array<uint64_t>(arena, n_leaves);
+    tree->n_leaves = n_leaves;
+    tree->remaining = 0;
+
+    // winners[node] of every subtree, leaves sit at n_leaves + leaf
+    sort_arena_mark_t winners_mark = sort_arena_mark(arena);
+    uint64_t *winners = sort_arena_array<uint64_t>(arena, 2 * n_leaves);
+
+    for (uint32_t leaf = 0; leaf < n_leaves; ++leaf) {
+        tree->heads[leaf] = (leaf < k) ? runs[leaf] : NULL;
+        tree->ends[leaf] = (leaf < k) ? runs[leaf] + run_lens[leaf] : NULL;
+        tree->remaining += (leaf < k) ? run_lens[leaf] : 0;
+        winners[n_leaves + leaf] = leaf_key(tree, leaf);
+    }
+
+    for (size_t node = n_leaves - 1; node > 0; --node) {
+        uint64_t left = winners[2 * node];
+        uint64_t right = winners[2 * node + 1];
+
+        winners[node] = (left < right) ? left : right;
+        tree->keys[node] = (left < right) ? right : left;
+    }
+
+    tree->keys[0] = winners[1];
+    sort_arena_release(arena, winners_mark);
+}
+
+void loser_tree_free (loser_tree_t *tree) {
+    sort_arena_release(tree->arena, tree->mark);
+}
+
+/// Nodes store whole keys, so the loads along the path don't wait on the previous compare
+size_t loser_tree_merge (loser_tree_t *tree, int *out, size_t out_len) {
+    size_t count = (out_len < tree->remaining) ? out_len : tree->remaining;
+    uint64_t *keys = tree->keys;
+    uint64_t winner = keys[0];
+
+    for (size_t i = 0; i < count; ++i) {
+        uint32_t run = (uint32_t) (winner & LOSER_KEY_RUN_MASK);
+
+        out[i] = (int) ((uint32_t) (winner >> LOSER_KEY_RUN_BITS) ^ 0x80000000u);
+        ++tree->heads[run];
+        winner = leaf_key(tree, run);
+
+        for (size_t node = (tree->n_leaves + run) / 2; node > 0; node /= 2) {
+            uint64_t loser = keys[node];
+            bool loser_wins = loser < winner;
+
+            keys[node] = loser_wins ? winner : loser;
+            winner = loser_wins ? loser : winner;
+        }
+    }
+
+    keys[0] = winner;
+    tree->remaining -= count;
+
+    return count;
+}
+
+void merge_k_way (const int *const *runs, const size_t *run_lens, size_t k, int *out) {
+    merge_k_way(runs, run_lens, k, out, sort_arena_local());
+}
+
+void merge_k_way (const int *const *runs, const size_t *run_lens, size_t k, int *out, sort_arena_t *arena) {
+    loser_tree_t tree;
+
+    loser_tree_init(&tree, runs, run_lens, k, arena);
+    loser_tree_merge(&tree, out, tree.remaining);
+    loser_tree_free(&tree);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+// lib functions
+// ---------------------------------------------------------------------------------------------------------------------
+
+/// Distinct for every leaf, so the compare never sees a tie
+static inline uint64_t leaf_key (const loser_tree_t *tree, uint32_t leaf) {
+    if (tree->heads[leaf] == tree->ends[leaf]) {
+        return LOSER_KEY_EXHAUSTED | leaf;
+    }
+
+    uint32_t value = (uint32_t) *tree->heads[leaf] ^ 0x80000000u;
+    return ((uint64_t) value << LOSER_KEY_RUN_BITS) | leaf;
+}
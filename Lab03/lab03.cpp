@@ -2,11 +2,14 @@
 #include <stdio.h>
 #include <time.h>
 #include <string.h>
+#include <math.h>
 #include <sys/time.h>
 #include "sorts.h"
 #include <algorithm>
 
 //#define TEST
+//#define CALIBRATE
+//#define TUNE
 
 #ifdef TEST
 #include "tests.h"
@@ -18,12 +21,28 @@ const int ERROR = -1;
 const int ITERATION_NUM = 5;
 
 long bench_sorting_algo (const int * orig_array, size_t len, sort_func_t sort_algo);
+long bench_sorting_doubles (const double * orig_array, size_t len, void (*sort_algo)(double *array, size_t len));
+long bench_sorting_kv (const int * orig_keys, size_t len, kv_sort_func_t sort_algo);
+void qsort_records (int *keys, uint32_t *values, size_t len);
+long bench_segmented_sort (const int * orig_array, const size_t *offsets, size_t n_segments,
+                           void (*sort_algo)(int *array, const size_t *offsets, size_t n_segments));
+size_t *gen_mixed_segments(size_t n_segments);
+long bench_merging_runs (const int * runs, const size_t *offsets, size_t n_runs,
+                         void (*merge_algo)(const int *runs, const size_t *offsets, size_t n_runs, int *out));
+void merge_runs_k_way (const int *runs, const size_t *offsets, size_t n_runs, int *out);
+void merge_runs_pairwise (const int *runs, const size_t *offsets, size_t n_runs, int *out);
+void print_sort_auto_calibration();
+void tune_sorts();
 
 int *gen_rand_array(size_t len);
 int *gen_equal_array(size_t len);
 int *gen_lot_same_increasing_array(size_t len);
 int *gen_zebra_array(size_t len);
 int *gen_u_shape_array(size_t len);
+int *gen_range_array(size_t len, size_t range);
+int *gen_presorted_array(size_t len, size_t n_swaps);
+int *gen_few_unique_array(size_t len, int n_unique);
+double *gen_rand_double_array(size_t len);
 
 // ---------------------------------------------------------------------------------------------------------------------
 // ---------------------------------------------------------------------------------------------------------------------
@@ -31,6 +50,10 @@ int *gen_u_shape_array(size_t len);
 int main () {
 #ifdef TEST
     test_sorts();
+#elif defined(CALIBRATE)
+    print_sort_auto_calibration();
+#elif defined(TUNE)
+    tune_sorts();
 #else
 //    enki::TaskScheduler g_TS;
 //    g_TS.Initialize();
@@ -102,10 +125,187 @@ int main () {
         printf("Quick Median Sort :: USHAPE,%zu,%ld\n", len, bench_sorting_algo(array, len, qsort_median));
         printf("Quick Central Sort :: USHAPE,%zu,%ld\n", len, bench_sorting_algo(array, len, qsort_central));
         printf("Quick Random Sort :: USHAPE,%zu,%ld\n", len, bench_sorting_algo(array, len, qsort_random));
+        printf("Quick Dual Pivot Sort :: USHAPE,%zu,%ld\n", len, bench_sorting_algo(array, len, qsort_dual_pivot));
+        printf("Quick Sort Pivot Ninther :: USHAPE,%zu,%ld\n", len,
+               bench_sorting_algo(array, len, qsort_pivot<PIVOT_NINTHER>));
+        printf("Quick Sort Pivot SqrtSample :: USHAPE,%zu,%ld\n", len,
+               bench_sorting_algo(array, len, qsort_pivot<PIVOT_SQRT_SAMPLE>));
+        printf("Quick Sort Pivot MedianOfMedians :: USHAPE,%zu,%ld\n", len,
+               bench_sorting_algo(array, len, qsort_pivot<PIVOT_MEDIAN_OF_MEDIANS>));
+        printf("Quick Sort Pivot Xorshift :: USHAPE,%zu,%ld\n", len,
+               bench_sorting_algo(array, len, qsort_pivot<PIVOT_XORSHIFT>));
+        printf("Quick Block Sort :: USHAPE,%zu,%ld\n", len, bench_sorting_algo(array, len, qsort_block));
+        printf("Quick SIMD Sort :: USHAPE,%zu,%ld\n", len, bench_sorting_algo(array, len, qsort_simd));
+        printf("Merge Sort #16 :: USHAPE,%zu,%ld\n", len, bench_sorting_algo(array, len, merge_sort<16>));
+        printf("Merge Sort #64 :: USHAPE,%zu,%ld\n", len, bench_sorting_algo(array, len, merge_sort<64>));
+        printf("Powersort :: USHAPE,%zu,%ld\n", len, bench_sorting_algo(array, len, powersort));
+        printf("Sort Auto :: USHAPE,%zu,%ld\n", len, bench_sorting_algo(array, len, sort_auto));
 
         fflush(stdout);
         free (array);
     }
+
+    for (size_t len = 1000 + 100000 * 0; len <= 500000 * 20; len += 500000) {
+        int *array = gen_lot_same_increasing_array(len);
+
+        printf("Quick Median Sort :: LOTSAME,%zu,%ld\n", len, bench_sorting_algo(array, len, qsort_median));
+        printf("Quick Dual Pivot Sort :: LOTSAME,%zu,%ld\n", len, bench_sorting_algo(array, len, qsort_dual_pivot));
+        printf("Merge Sort #16 :: LOTSAME,%zu,%ld\n", len, bench_sorting_algo(array, len, merge_sort<16>));
+        printf("Powersort :: LOTSAME,%zu,%ld\n", len, bench_sorting_algo(array, len, powersort));
+        printf("Sort Auto :: LOTSAME,%zu,%ld\n", len, bench_sorting_algo(array, len, sort_auto));
+
+        fflush(stdout);
+        free (array);
+    }
+
+    for (size_t len = 1000000; len <= 100000000; len += 9900000) {
+        int *array = gen_rand_array(len);
+
+        printf("Quick Median Sort,%zu,%ld\n", len, bench_sorting_algo(array, len, qsort_median));
+        printf("Quick Dual Pivot Sort,%zu,%ld\n", len, bench_sorting_algo(array, len, qsort_dual_pivot));
+        printf("Quick Sort Pivot Ninther,%zu,%ld\n", len, bench_sorting_algo(array, len, qsort_pivot<PIVOT_NINTHER>));
+        printf("Quick Sort Pivot SqrtSample,%zu,%ld\n", len,
+               bench_sorting_algo(array, len, qsort_pivot<PIVOT_SQRT_SAMPLE>));
+        printf("Quick Sort Pivot MedianOfMedians,%zu,%ld\n", len,
+               bench_sorting_algo(array, len, qsort_pivot<PIVOT_MEDIAN_OF_MEDIANS>));
+        printf("Quick Sort Pivot Xorshift,%zu,%ld\n", len, bench_sorting_algo(array, len, qsort_pivot<PIVOT_XORSHIFT>));
+
+        printf("Select p99,%zu,%ld\n", len, bench_sorting_algo(array, len, [] (int *array, size_t len) {
+            select_kth(array, len, len * 99 / 100);
+        }));
+        printf("Partial Sort #1000,%zu,%ld\n", len, bench_sorting_algo(array, len, [] (int *array, size_t len) {
+            partial_sort(array, len, 1000);
+        }));
+        printf("Top K #1000,%zu,%ld\n", len, bench_sorting_algo(array, len, [] (int *array, size_t len) {
+            static int out[1000];
+            top_k(array, len, 1000, out);
+        }));
+        printf("Quick Block Sort,%zu,%ld\n", len, bench_sorting_algo(array, len, qsort_block));
+        printf("Quick SIMD Sort,%zu,%ld\n", len, bench_sorting_algo(array, len, qsort_simd));
+
+        printf("Radix Sort,%zu,%ld\n", len, bench_sorting_algo(array, len, radix_sort));
+        printf("Radix Sort MSD,%zu,%ld\n", len, bench_sorting_algo(array, len, radix_sort_msd));
+        printf("Radix Sort Parallel #1,%zu,%ld\n", len, bench_sorting_algo(array, len, radix_sort_parallel<1>));
+        printf("Radix Sort Parallel #2,%zu,%ld\n", len, bench_sorting_algo(array, len, radix_sort_parallel<2>));
+        printf("Radix Sort Parallel #4,%zu,%ld\n", len, bench_sorting_algo(array, len, radix_sort_parallel<4>));
+        printf("Radix Sort Parallel #8,%zu,%ld\n", len, bench_sorting_algo(array, len, radix_sort_parallel<8>));
+        printf("Radix Sort Parallel #16,%zu,%ld\n", len, bench_sorting_algo(array, len, radix_sort_parallel<16>));
+
+        printf("Merge Sort #16,%zu,%ld\n", len, bench_sorting_algo(array, len, merge_sort<16>));
+        printf("Merge Sort #64,%zu,%ld\n", len, bench_sorting_algo(array, len, merge_sort<64>));
+        printf("Merge Sort PingPong #16,%zu,%ld\n", len,
+               bench_sorting_algo(array, len, merge_sort_pingpong<16, MERGE_BRANCHY>));
+        printf("Merge Sort PingPong Branchless #16,%zu,%ld\n", len,
+               bench_sorting_algo(array, len, merge_sort_pingpong<16, MERGE_BRANCHLESS>));
+        printf("Merge Sort PingPong SIMD #16,%zu,%ld\n", len,
+               bench_sorting_algo(array, len, merge_sort_pingpong<16, MERGE_SIMD>));
+        printf("Merge Sort BottomUp 4-way #32K,%zu,%ld\n", len,
+               bench_sorting_algo(array, len, merge_sort_bottom_up<32 * 1024>));
+        printf("Merge Sort BottomUp 4-way #256K,%zu,%ld\n", len,
+               bench_sorting_algo(array, len, merge_sort_bottom_up<256 * 1024>));
+        printf("Merge Sort InPlace,%zu,%ld\n", len, bench_sorting_algo(array, len, merge_sort_inplace));
+        printf("Merge Sort Parallel #1,%zu,%ld\n", len, bench_sorting_algo(array, len, merge_sort_parallel<1>));
+        printf("Merge Sort Parallel #2,%zu,%ld\n", len, bench_sorting_algo(array, len, merge_sort_parallel<2>));
+        printf("Merge Sort Parallel #4,%zu,%ld\n", len, bench_sorting_algo(array, len, merge_sort_parallel<4>));
+        printf("Merge Sort Parallel #8,%zu,%ld\n", len, bench_sorting_algo(array, len, merge_sort_parallel<8>));
+        printf("Merge Sort Parallel #16,%zu,%ld\n", len, bench_sorting_algo(array, len, merge_sort_parallel<16>));
+
+        printf("Sample Sort #1,%zu,%ld\n", len, bench_sorting_algo(array, len, sample_sort<1>));
+        printf("Sample Sort #2,%zu,%ld\n", len, bench_sorting_algo(array, len, sample_sort<2>));
+        printf("Sample Sort #4,%zu,%ld\n", len, bench_sorting_algo(array, len, sample_sort<4>));
+        printf("Sample Sort #8,%zu,%ld\n", len, bench_sorting_algo(array, len, sample_sort<8>));
+        printf("Sample Sort #16,%zu,%ld\n", len, bench_sorting_algo(array, len, sample_sort<16>));
+
+        printf("Sort Auto,%zu,%ld\n", len, bench_sorting_algo(array, len, sort_auto));
+
+        fflush(stdout);
+        free (array);
+    }
+
+    for (size_t len = 1000000; len <= 100000000; len += 9900000) {
+        int *equal_array = gen_equal_array(len);
+        int *zebra_array = gen_zebra_array(len);
+
+        printf("Sample Sort #8 :: EQUAL,%zu,%ld\n", len, bench_sorting_algo(equal_array, len, sample_sort<8>));
+        printf("Sample Sort #8 :: ZEBRA,%zu,%ld\n", len, bench_sorting_algo(zebra_array, len, sample_sort<8>));
+        printf("Counting Sort :: EQUAL,%zu,%ld\n", len, bench_sorting_algo(equal_array, len, counting_sort));
+        printf("Counting Sort :: ZEBRA,%zu,%ld\n", len, bench_sorting_algo(zebra_array, len, counting_sort));
+        printf("Quick Dual Pivot Sort :: EQUAL,%zu,%ld\n", len, bench_sorting_algo(equal_array, len, qsort_dual_pivot));
+        printf("Quick Dual Pivot Sort :: ZEBRA,%zu,%ld\n", len, bench_sorting_algo(zebra_array, len, qsort_dual_pivot));
+        printf("Sort Auto :: EQUAL,%zu,%ld\n", len, bench_sorting_algo(equal_array, len, sort_auto));
+        printf("Sort Auto :: ZEBRA,%zu,%ld\n", len, bench_sorting_algo(zebra_array, len, sort_auto));
+
+        fflush(stdout);
+        free (equal_array);
+        free (zebra_array);
+    }
+
+    for (size_t len = 1000000; len <= 100000000; len += 9900000) {
+        double *array = gen_rand_double_array(len);
+
+        printf("Radix Sort :: DOUBLE,%zu,%ld\n", len, bench_sorting_doubles(array, len, radix_sort));
+        printf("std::sort :: DOUBLE,%zu,%ld\n", len,
+               bench_sorting_doubles(array, len, [] (double *array, size_t len) { std::sort(array, array + len); }));
+
+        fflush(stdout);
+        free (array);
+    }
+
+    for (size_t len = 1000000; len <= 100000000; len += 9900000) {
+        int *keys = gen_rand_array(len);
+
+        printf("Radix Sort KV,%zu,%ld\n", len, bench_sorting_kv(keys, len, radix_sort_kv));
+        printf("Merge Sort KV,%zu,%ld\n", len, bench_sorting_kv(keys, len, merge_sort_kv));
+        printf("Quick Sort KV,%zu,%ld\n", len, bench_sorting_kv(keys, len, qsort_kv));
+        printf("qsort records,%zu,%ld\n", len, bench_sorting_kv(keys, len, qsort_records));
+
+        fflush(stdout);
+        free (keys);
+    }
+
+    for (size_t n_segments = 250000; n_segments <= 1000000; n_segments += 250000) {
+        size_t *offsets = gen_mixed_segments(n_segments);
+        int *array = gen_rand_array(offsets[n_segments]);
+
+        printf("Quick Median Sort per segment :: SEGMENTED,%zu,%ld\n", n_segments,
+               bench_segmented_sort(array, offsets, n_segments, [] (int *array, const size_t *offsets, size_t n) {
+                   for (size_t seg = 0; seg < n; ++seg) {
+                       qsort_median(array + offsets[seg], offsets[seg+1] - offsets[seg]);
+                   }
+               }));
+        printf("Segmented Sort #1 :: SEGMENTED,%zu,%ld\n", n_segments,
+               bench_segmented_sort(array, offsets, n_segments, segmented_sort<1>));
+        printf("Segmented Sort #4 :: SEGMENTED,%zu,%ld\n", n_segments,
+               bench_segmented_sort(array, offsets, n_segments, segmented_sort<4>));
+        printf("Segmented Sort #16 :: SEGMENTED,%zu,%ld\n", n_segments,
+               bench_segmented_sort(array, offsets, n_segments, segmented_sort<16>));
+
+        fflush(stdout);
+        free (array);
+        free (offsets);
+    }
+
+    for (size_t n_runs = 4; n_runs <= 1024; n_runs *= 2) {
+        size_t len = 1 << 24;
+        int *runs = gen_rand_array(len);
+        size_t *offsets = (size_t*) malloc((n_runs + 1) * sizeof (size_t));
+
+        for (size_t run = 0; run <= n_runs; ++run) {
+            offsets[run] = len * run / n_runs;
+        }
+
+        for (size_t run = 0; run < n_runs; ++run) {
+            qsort_simd(runs + offsets[run], offsets[run+1] - offsets[run]);
+        }
+
+        printf("Merge K-Way :: RUNS,%zu,%ld\n", n_runs, bench_merging_runs(runs, offsets, n_runs, merge_runs_k_way));
+        printf("Merge Pairwise :: RUNS,%zu,%ld\n", n_runs,
+               bench_merging_runs(runs, offsets, n_runs, merge_runs_pairwise));
+
+        fflush(stdout);
+        free (runs);
+        free (offsets);
+    }
 //    });
 
 //    g_TS.AddTaskSetToPipe( &quadratic_sorts_tests );
@@ -142,6 +342,372 @@ long bench_sorting_algo (const int * orig_array, size_t len, sort_func_t sort_al
     return elapsed_us;
 }
 
+long bench_sorting_doubles (const double * orig_array, size_t len, void (*sort_algo)(double *array, size_t len)) {
+    struct timeval start, stop;
+    long long unsigned int elapsed_us = 0;
+    double *array = (double*) malloc(len * sizeof (double));
+
+    for (int i = 0; i < ITERATION_NUM; ++i) {
+        memcpy (array, orig_array, len * sizeof (double));
+        gettimeofday(&start, NULL);
+
+        sort_algo(array, len);
+
+        gettimeofday(&stop, NULL);
+        elapsed_us += (stop.tv_sec - start.tv_sec) * 1000000 + (stop.tv_usec - start.tv_usec);
+    }
+
+    free (array);
+
+    elapsed_us /= ITERATION_NUM;
+    return elapsed_us;
+}
+
+/// Values are reset to positions before every run
+long bench_sorting_kv (const int * orig_keys, size_t len, kv_sort_func_t sort_algo) {
+    struct timeval start, stop;
+    long long unsigned int elapsed_us = 0;
+    int *keys = (int*) malloc(len * sizeof (int));
+    uint32_t *values = (uint32_t*) malloc(len * sizeof (uint32_t));
+
+    for (int i = 0; i < ITERATION_NUM; ++i) {
+        memcpy (keys, orig_keys, len * sizeof (int));
+
+        for (size_t j = 0; j < len; ++j) {
+            values[j] = (uint32_t) j;
+        }
+
+        gettimeofday(&start, NULL);
+
+        sort_algo(keys, values, len);
+
+        gettimeofday(&stop, NULL);
+        elapsed_us += (stop.tv_sec - start.tv_sec) * 1000000 + (stop.tv_usec - start.tv_usec);
+    }
+
+    free (keys);
+    free (values);
+
+    elapsed_us /= ITERATION_NUM;
+    return elapsed_us;
+}
+
+long bench_segmented_sort (const int * orig_array, const size_t *offsets, size_t n_segments,
+                           void (*sort_algo)(int *array, const size_t *offsets, size_t n_segments)) {
+    struct timeval start, stop;
+    long long unsigned int elapsed_us = 0;
+    size_t len = offsets[n_segments];
+    int *array = (int*) malloc(len * sizeof (int));
+
+    for (int i = 0; i < ITERATION_NUM; ++i) {
+        memcpy (array, orig_array, len * sizeof (int));
+        gettimeofday(&start, NULL);
+
+        sort_algo(array, offsets, n_segments);
+
+        gettimeofday(&stop, NULL);
+        elapsed_us += (stop.tv_sec - start.tv_sec) * 1000000 + (stop.tv_usec - start.tv_usec);
+    }
+
+    free (array);
+
+    elapsed_us /= ITERATION_NUM;
+    return elapsed_us;
+}
+
+long bench_merging_runs (const int * runs, const size_t *offsets, size_t n_runs,
+                         void (*merge_algo)(const int *runs, const size_t *offsets, size_t n_runs, int *out)) {
+    struct timeval start, stop;
+    long long unsigned int elapsed_us = 0;
+    int *out = (int*) malloc(offsets[n_runs] * sizeof (int));
+
+    for (int i = 0; i < ITERATION_NUM; ++i) {
+        gettimeofday(&start, NULL);
+
+        merge_algo(runs, offsets, n_runs, out);
+
+        gettimeofday(&stop, NULL);
+        elapsed_us += (stop.tv_sec - start.tv_sec) * 1000000 + (stop.tv_usec - start.tv_usec);
+    }
+
+    free (out);
+
+    elapsed_us /= ITERATION_NUM;
+    return elapsed_us;
+}
+
+void merge_runs_k_way (const int *runs, const size_t *offsets, size_t n_runs, int *out) {
+    const int **heads = (const int**) malloc(n_runs * sizeof (int*));
+    size_t *lens = (size_t*) malloc(n_runs * sizeof (size_t));
+
+    for (size_t run = 0; run < n_runs; ++run) {
+        heads[run] = runs + offsets[run];
+        lens[run] = offsets[run+1] - offsets[run];
+    }
+
+    merge_k_way(heads, lens, n_runs, out);
+
+    free (heads);
+    free (lens);
+}
+
+/// Baseline: a cascade of two-way merges, every level streams the whole data once more
+void merge_runs_pairwise (const int *runs, const size_t *offsets, size_t n_runs, int *out) {
+    size_t len = offsets[n_runs];
+    int *buf = (int*) malloc(len * sizeof (int));
+    size_t *bounds = (size_t*) malloc((n_runs + 1) * sizeof (size_t));
+    const int *src = runs;
+    int *dst = out;
+
+    memcpy(bounds, offsets, (n_runs + 1) * sizeof (size_t));
+
+    while (n_runs > 1) {
+        size_t merged = 0;
+
+        for (size_t run = 0; run < n_runs; run += 2) {
+            size_t left = bounds[run];
+
+            if (run + 1 == n_runs) {
+                memcpy(dst + left, src + left, (len - left) * sizeof (int));
+            } else {
+                merge_branchless(src + left, src + bounds[run+1], bounds[run+1] - left,
+                                 bounds[run+2] - bounds[run+1], dst + left);
+            }
+
+            bounds[merged++] = left;
+        }
+
+        bounds[merged] = len;
+        n_runs = merged;
+        src = dst;
+        dst = (dst == out) ? buf : out;
+    }
+
+    if (src != out) {
+        memcpy(out, src, len * sizeof (int));
+    }
+
+    free (buf);
+    free (bounds);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+const size_t CALIBRATION_SIZE = 1 << 20;
+const size_t CALIBRATION_RADIX_MIN_SIZE = 1 << 8;
+const size_t CALIBRATION_RADIX_STEPS = 17;
+const int CALIBRATION_ROUNDS = 3;
+
+// sort_auto with the structure checks switched off: radix or introsort depending on size
+static sort_auto_calibration_t calibration_baseline = {SIZE_MAX, SIZE_MAX, 0, -1, -1};
+
+static void sort_baseline (int *array, size_t len) {
+    sort_auto(array, len, calibration_baseline);
+}
+
+/// Best of several bench runs, other load on the host only ever adds time
+static long bench_best (const int *array, size_t len, sort_func_t sort_algo) {
+    long best_us = bench_sorting_algo(array, len, sort_algo);
+
+    for (int round = 1; round < CALIBRATION_ROUNDS; ++round) {
+        best_us = std::min(best_us, bench_sorting_algo(array, len, sort_algo));
+    }
+
+    return best_us;
+}
+
+/// Direction turns per sampled element, as seen by sort_auto
+static double sample_turns_ratio (const int *array, size_t len) {
+    sample_stats_t stats = sample_stats(array, len);
+    return (double) stats.turns / (double) stats.size;
+}
+
+/// Measures every sort_auto threshold on this host and prints sort_auto_calibration.h:
+/// build lab03 with CALIBRATE defined and run ./lab03 > sort_auto_calibration.h
+void print_sort_auto_calibration () {
+    sort_auto_calibration_t calibration = {SIZE_MAX, SIZE_MAX, 0, 0, 0};
+
+    // Radix wins on random input inside a window: below it the passes don't pay off, above it the scatter
+    // falls out of cache. A bound is only moved when two sizes in a row agree, single runs are noisy
+    bool radix_won[CALIBRATION_RADIX_STEPS];
+
+    for (size_t step = 0; step < CALIBRATION_RADIX_STEPS; ++step) {
+        size_t len = CALIBRATION_RADIX_MIN_SIZE << step;
+        int *array = gen_rand_array(len);
+        radix_won[step] = bench_best(array, len, radix_sort) < bench_best(array, len, qsort_simd);
+        free (array);
+    }
+
+    for (size_t step = 0; step + 1 < CALIBRATION_RADIX_STEPS; ++step) {
+        size_t len = CALIBRATION_RADIX_MIN_SIZE << step;
+
+        if (calibration.radix_min_size == SIZE_MAX && radix_won[step] && radix_won[step + 1]) {
+            calibration.radix_min_size = len;
+        } else if (calibration.radix_min_size != SIZE_MAX && !radix_won[step] && !radix_won[step + 1]) {
+            calibration.radix_max_size = len;
+            break;
+        }
+    }
+
+    calibration_baseline.radix_min_size = calibration.radix_min_size;
+    calibration_baseline.radix_max_size = calibration.radix_max_size;
+
+    // Widest value range, relative to len, where counting still beats the baseline
+    for (double ratio = 1.0 / 16; ratio <= 16; ratio *= 2) {
+        int *array = gen_range_array(CALIBRATION_SIZE, (size_t) (ratio * CALIBRATION_SIZE));
+        long counting_us = bench_best(array, CALIBRATION_SIZE, [] (int *array, size_t len) {
+            counting_sort_try(array, len, SIZE_MAX);
+        });
+        bool counting_wins = counting_us < bench_best(array, CALIBRATION_SIZE, sort_baseline);
+        free (array);
+
+        if (!counting_wins) {
+            break;
+        }
+
+        calibration.counting_range_ratio = ratio;
+    }
+
+    // Most disorder powersort still turns into a win, from sorted input up
+    for (size_t n_swaps = 1; n_swaps <= CALIBRATION_SIZE / 4; n_swaps *= 4) {
+        int *array = gen_presorted_array(CALIBRATION_SIZE, n_swaps);
+        double turns = sample_turns_ratio(array, CALIBRATION_SIZE);
+        bool powersort_wins = bench_best(array, CALIBRATION_SIZE, powersort) <
+                              bench_best(array, CALIBRATION_SIZE, sort_baseline);
+        free (array);
+
+        if (!powersort_wins) {
+            break;
+        }
+
+        calibration.presorted_max_ratio = std::max(calibration.presorted_max_ratio, turns);
+    }
+
+    // Most distinct values the dual-pivot quicksort still wins with; values are spread so counting cannot take them
+    for (int n_unique = 2; n_unique <= (int) SORT_NETWORK_MAX_SIZE * 4; n_unique *= 2) {
+        int *array = gen_few_unique_array(CALIBRATION_SIZE, n_unique);
+        sample_stats_t stats = sample_stats(array, CALIBRATION_SIZE);
+        bool dual_pivot_wins = bench_best(array, CALIBRATION_SIZE, qsort_dual_pivot) <
+                               bench_best(array, CALIBRATION_SIZE, sort_baseline);
+        free (array);
+
+        if (!dual_pivot_wins) {
+            break;
+        }
+
+        calibration.duplicate_max_ratio = std::max(calibration.duplicate_max_ratio,
+                                                   (double) stats.distinct / (double) stats.size);
+    }
+
+    printf("#ifndef ALGO_SORT_AUTO_CALIBRATION_H\n");
+    printf("#define ALGO_SORT_AUTO_CALIBRATION_H\n\n");
+    printf("#include \"sorts.h\"\n\n");
+    printf("// Generated by lab03 built with CALIBRATE defined, rerun it on the target host instead of editing\n\n");
+    printf("const sort_auto_calibration_t SORT_AUTO_CALIBRATION = {\n");
+
+    if (calibration.radix_min_size == SIZE_MAX) {
+        printf("    SIZE_MAX,   // radix_min_size\n");
+    } else {
+        printf("    %zu,   // radix_min_size\n", calibration.radix_min_size);
+    }
+
+    if (calibration.radix_max_size == SIZE_MAX) {
+        printf("    SIZE_MAX,   // radix_max_size\n");
+    } else {
+        printf("    %zu,   // radix_max_size\n", calibration.radix_max_size);
+    }
+
+    printf("    %.4f,   // counting_range_ratio\n", calibration.counting_range_ratio);
+    printf("    %.4f,   // presorted_max_ratio\n", calibration.presorted_max_ratio);
+    printf("    %.4f,   // duplicate_max_ratio\n", calibration.duplicate_max_ratio);
+    printf("};\n\n");
+    printf("#endif //ALGO_SORT_AUTO_CALIBRATION_H\n");
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+const size_t TUNING_SIZE = 1 << 20;
+
+/// Sets each candidate into the process tuning and keeps the fastest one there
+template <typename T, size_t n_candidates>
+static void tune_parameter (const int *array, const char *name, T sort_tuning_t::*param,
+                            const T (&candidates)[n_candidates], sort_func_t sort_algo) {
+    sort_tuning_t tuning = sort_tuning();
+    long best_us = -1;
+    T best = tuning.*param;
+
+    for (T candidate : candidates) {
+        tuning.*param = candidate;
+        sort_tuning_set(tuning);
+
+        long us = bench_best(array, TUNING_SIZE, sort_algo);
+        printf("Tune %s,%zu,%ld\n", name, (size_t) candidate, us);
+        fflush(stdout);
+
+        if (best_us < 0 || us < best_us) {
+            best_us = us;
+            best = candidate;
+        }
+    }
+
+    tuning.*param = best;
+    sort_tuning_set(tuning);
+}
+
+/// Measures sort_tuning_t on random input of TUNING_SIZE and writes it to sort_tuning_path(), which the library
+/// reads on startup. Build lab03 with TUNE defined and run it once per host
+void tune_sorts () {
+    int *array = gen_rand_array(TUNING_SIZE);
+    const unsigned int merge_sizes[] = {4, 8, 16, 32, 64, 128, 256, 512};
+    const unsigned int radix_bits[] = {4, 6, 8, 11, 16};
+    const size_t qsort_sizes[] = {8, 12, 16, 24, 32, 48, 64};
+
+    tune_parameter(array, "merge_small_size", &sort_tuning_t::merge_small_size, merge_sizes, merge_sort);
+    // Measured at the raw width, radix_sort would narrow the wider candidates at TUNING_SIZE; the result is a ceiling
+    tune_parameter(array, "radix_bits", &sort_tuning_t::radix_bits, radix_bits, [] (int *array, size_t len) {
+        radix_sort(array, len, sort_tuning().radix_bits);
+    });
+    tune_parameter(array, "qsort_small_size", &sort_tuning_t::qsort_small_size, qsort_sizes, qsort_simd);
+
+    free (array);
+
+    if (!sort_tuning_save(sort_tuning_path(), sort_tuning())) {
+        fprintf(stderr, "Cannot write %s\n", sort_tuning_path());
+        return;
+    }
+
+    printf("Tuning written to %s\n", sort_tuning_path());
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+struct record_t {
+    int key;
+    uint32_t value;
+};
+
+/// Baseline: the same pairs sorted as structs through the libc qsort callback
+void qsort_records (int *keys, uint32_t *values, size_t len) {
+    record_t *records = (record_t *) malloc(len * sizeof (record_t));
+
+    for (size_t i = 0; i < len; ++i) {
+        records[i] = {keys[i], values[i]};
+    }
+
+    qsort(records, len, sizeof (record_t), [] (const void *a, const void *b) {
+        int lhs = ((const record_t *) a)->key;
+        int rhs = ((const record_t *) b)->key;
+        return (lhs > rhs) - (lhs < rhs);
+    });
+
+    for (size_t i = 0; i < len; ++i) {
+        keys[i] = records[i].key;
+        values[i] = records[i].value;
+    }
+
+    free (records);
+}
+
 // ---------------------------------------------------------------------------------------------------------------------
 
 int *gen_rand_array(size_t len) {
@@ -193,3 +759,65 @@ int *gen_u_shape_array(size_t len) {
 
     return array;
 }
+
+/// Uniform values in [0, range)
+int *gen_range_array(size_t len, size_t range) {
+    int *array = (int *) calloc(len, sizeof (int));
+
+    for (size_t i = 0; i < len; ++i) {
+        array[i] = (int) (((size_t) rand() * (RAND_MAX + 1u) + rand()) % range);
+    }
+
+    return array;
+}
+
+/// Increasing values with n_swaps random pairs exchanged
+int *gen_presorted_array(size_t len, size_t n_swaps) {
+    int *array = (int *) calloc(len, sizeof (int));
+
+    for (size_t i = 0; i < len; ++i) {
+        array[i] = (int) i;
+    }
+
+    for (size_t i = 0; i < n_swaps; ++i) {
+        std::swap(array[rand() % len], array[rand() % len]);
+    }
+
+    return array;
+}
+
+/// n_unique values spread over the whole int range
+int *gen_few_unique_array(size_t len, int n_unique) {
+    int *array = (int *) calloc(len, sizeof (int));
+
+    for (size_t i = 0; i < len; ++i) {
+        array[i] = (rand() % n_unique) * (RAND_MAX / n_unique);
+    }
+
+    return array;
+}
+
+/// Returns n_segments + 1 offsets: mostly rows under 32 elements, some up to 512, a few up to 2048
+size_t *gen_mixed_segments(size_t n_segments) {
+    size_t *offsets = (size_t *) calloc(n_segments + 1, sizeof (size_t));
+
+    for (size_t seg = 0; seg < n_segments; ++seg) {
+        int kind = rand() % 100;
+        size_t seg_len = (kind < 90) ? rand() % 32 : (kind < 99) ? 32 + rand() % 480 : 512 + rand() % 1536;
+
+        offsets[seg+1] = offsets[seg] + seg_len;
+    }
+
+    return offsets;
+}
+
+/// Telemetry-like values: both signs, wide exponent range
+double *gen_rand_double_array(size_t len) {
+    double *array = (double *) calloc(len, sizeof (double));
+
+    for (size_t i = 0; i < len; ++i) {
+        array[i] = (rand() - RAND_MAX / 2) * ldexp(1.0, rand() % 64 - 32);
+    }
+
+    return array;
+}
@@ -0,0 +1,414 @@
+#include <string.h>
+#include <stdint.h>
+#include "sorts.h"
+#include "enkiTS/src/TaskScheduler.h"
+
+typedef unsigned int uint;
+
+// Chunks smaller than this are not worth a separate task
+const size_t PARALLEL_MIN_CHUNK_SIZE = 1 << 14;
+
+// Leaf cutoff passed to the sequential merge_sort
+const uint PARALLEL_MERGE_SWITCH_SIZE = 16;
+
+const uint SAMPLE_SORT_OVERSAMPLING = 16;
+const uint SAMPLE_SORT_BUCKETS_PER_THREAD = 4;
+
+// Segments up to this size go straight to the sorting network, bigger ones are split by partitioning first
+const size_t SEGMENT_NETWORK_MAX_SIZE = 16;
+// From this size on segments are radix sorted
+const size_t SEGMENT_RADIX_MIN_SIZE = 256;
+// Segments are grouped into this many chunks per thread, balanced by element count
+const uint SEGMENT_CHUNKS_PER_THREAD = 8;
+
+static enki::TaskScheduler &get_scheduler ();
+static void parallel_for (uint n_chunks, const enki::TaskSetFunction &func);
+static uint limit_threads (size_t len, uint n_threads);
+
+static size_t choose_splitters (const int *array, size_t len, int *splitters, size_t n_splitters,
+                                sort_arena_t *arena);
+static inline uint classify (const int *splitters, size_t n_splitters, int value);
+
+static void merge_parallel (const int *left, size_t left_len, const int *right, size_t right_len, int *buf,
+                            uint n_threads);
+static size_t merge_path_split (const int *left, size_t left_len, const int *right, size_t right_len, size_t diag);
+static void merge_stable (const int *left, size_t left_len, const int *right, size_t right_len, int *buf);
+
+static void sort_segment (int *array, size_t len);
+static size_t find_segment (const size_t *offsets, size_t n_segments, size_t pos);
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void radix_sort_parallel (int *array, size_t len, unsigned int n_threads) {
+    radix_sort_parallel(array, len, n_threads, sort_arena_local());
+}
+
+/// Scratch comes from the calling thread's arena before any task starts
+void radix_sort_parallel (int *const array_orig, size_t len, unsigned int n_threads, sort_arena_t *arena) {
+    n_threads = limit_threads(len, n_threads);
+
+    if (n_threads < 2) {
+        radix_sort(array_orig, len, arena);
+        return;
+    }
+
+    sort_arena_mark_t mark = sort_arena_mark(arena);
+    int *array = array_orig;
+    int *buf = sort_arena_array<int>(arena, len);
+    int *tmp_ptr;
+
+    // offsets[t][digit] is first histogram of thread t, then its scatter position
+    size_t (*offsets)[RADIX_BASE] = (size_t (*)[RADIX_BASE]) sort_arena_alloc(arena, n_threads * sizeof(*offsets));
+
+    for (uint step = 0; step < sizeof (int); ++step) {
+        parallel_for(n_threads, [&] (enki::TaskSetPartition range, uint32_t) {
+            for (uint t = range.start; t < range.end; ++t) {
+                size_t *counters = offsets[t];
+                memset(counters, 0, RADIX_BASE * sizeof(size_t));
+
+                for (size_t i = len * t / n_threads; i < len * (t+1) / n_threads; ++i) {
+                    counters[radix_digit(array[i], step)]++;
+                }
+            }
+        });
+
+        // Digit-major, thread-minor prefix sum keeps the sort stable
+        size_t pos = 0;
+        for (uint digit = 0; digit < RADIX_BASE; ++digit) {
+            for (uint t = 0; t < n_threads; ++t) {
+                size_t count = offsets[t][digit];
+                offsets[t][digit] = pos;
+                pos += count;
+            }
+        }
+
+        parallel_for(n_threads, [&] (enki::TaskSetPartition range, uint32_t) {
+            for (uint t = range.start; t < range.end; ++t) {
+                size_t *counters = offsets[t];
+
+                for (size_t i = len * t / n_threads; i < len * (t+1) / n_threads; ++i) {
+                    buf[counters[radix_digit(array[i], step)]++] = array[i];
+                }
+            }
+        });
+
+        tmp_ptr = array;
+        array = buf;
+        buf = tmp_ptr;
+    }
+
+    if (array != array_orig) {
+        memcpy (array_orig, array, sizeof(int) * len);
+    }
+
+    sort_arena_release(arena, mark);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void merge_sort_parallel (int *array, size_t len, int *buf, unsigned int n_threads) {
+    n_threads = limit_threads(len, n_threads);
+
+    if (n_threads < 2) {
+        merge_sort(array, len, buf, PARALLEL_MERGE_SWITCH_SIZE);
+        return;
+    }
+
+    size_t half = len/2;
+    uint left_threads = n_threads/2;
+
+    enki::TaskSet left_task(1, [&] (enki::TaskSetPartition, uint32_t) {
+        merge_sort_parallel(array, half, buf, left_threads);
+    });
+
+    get_scheduler().AddTaskSetToPipe(&left_task);
+    merge_sort_parallel(array + half, len - half, buf + half, n_threads - left_threads);
+    get_scheduler().WaitforTask(&left_task);
+
+    merge_parallel(array, half, array + half, len - half, buf, n_threads);
+
+    parallel_for(n_threads, [&] (enki::TaskSetPartition range, uint32_t) {
+        size_t start = len * range.start / n_threads;
+        size_t end   = len * range.end   / n_threads;
+
+        memcpy(array + start, buf + start, (end - start) * sizeof(int));
+    });
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void sample_sort (int *array, size_t len, unsigned int n_threads) {
+    sample_sort(array, len, n_threads, sort_arena_local());
+}
+
+void sample_sort (int *array, size_t len, unsigned int n_threads, sort_arena_t *arena) {
+    n_threads = limit_threads(len, n_threads);
+    sort_arena_mark_t mark = sort_arena_mark(arena);
+    int *buf = sort_arena_array<int>(arena, len);
+
+    if (n_threads < 2) {
+        merge_sort(array, len, buf, PARALLEL_MERGE_SWITCH_SIZE);
+        sort_arena_release(arena, mark);
+        return;
+    }
+
+    int *splitters = sort_arena_array<int>(arena, n_threads * SAMPLE_SORT_BUCKETS_PER_THREAD);
+    size_t n_splitters = choose_splitters(array, len, splitters, n_threads * SAMPLE_SORT_BUCKETS_PER_THREAD - 1,
+                                          arena);
+
+    // Bucket 2i holds (splitters[i-1], splitters[i]), bucket 2i+1 holds values equal to splitters[i]
+    uint n_buckets = 2 * n_splitters + 1;
+
+    uint16_t *bucket_ids = sort_arena_array<uint16_t>(arena, len);
+    size_t *offsets      = sort_arena_array<size_t>(arena, n_threads * n_buckets);
+    size_t *bucket_start = sort_arena_array<size_t>(arena, n_buckets + 1);
+
+    memset(offsets, 0, n_threads * n_buckets * sizeof(size_t));
+
+    parallel_for(n_threads, [&] (enki::TaskSetPartition range, uint32_t) {
+        for (uint t = range.start; t < range.end; ++t) {
+            size_t *counters = offsets + t * n_buckets;
+
+            for (size_t i = len * t / n_threads; i < len * (t+1) / n_threads; ++i) {
+                bucket_ids[i] = classify(splitters, n_splitters, array[i]);
+                counters[bucket_ids[i]]++;
+            }
+        }
+    });
+
+    size_t pos = 0;
+    for (uint bucket = 0; bucket < n_buckets; ++bucket) {
+        bucket_start[bucket] = pos;
+
+        for (uint t = 0; t < n_threads; ++t) {
+            size_t count = offsets[t * n_buckets + bucket];
+            offsets[t * n_buckets + bucket] = pos;
+            pos += count;
+        }
+    }
+    bucket_start[n_buckets] = len;
+
+    parallel_for(n_threads, [&] (enki::TaskSetPartition range, uint32_t) {
+        for (uint t = range.start; t < range.end; ++t) {
+            size_t *counters = offsets + t * n_buckets;
+
+            for (size_t i = len * t / n_threads; i < len * (t+1) / n_threads; ++i) {
+                buf[counters[bucket_ids[i]]++] = array[i];
+            }
+        }
+    });
+
+    parallel_for(n_buckets, [&] (enki::TaskSetPartition range, uint32_t) {
+        for (uint bucket = range.start; bucket < range.end; ++bucket) {
+            size_t start = bucket_start[bucket];
+            size_t count = bucket_start[bucket+1] - start;
+
+            memcpy(array + start, buf + start, count * sizeof(int));
+
+            // Equality buckets are already sorted
+            if (bucket % 2 == 0 && count > 1) {
+                merge_sort(array + start, count, buf + start, PARALLEL_MERGE_SWITCH_SIZE);
+            }
+        }
+    });
+
+    sort_arena_release(arena, mark);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void segmented_sort (int *array, const size_t *offsets, size_t n_segments, unsigned int n_threads) {
+    if (n_segments == 0) {
+        return;
+    }
+
+    size_t first = offsets[0];
+    size_t total = offsets[n_segments] - first;
+
+    n_threads = limit_threads(total, n_threads);
+
+    if (n_threads < 2) {
+        for (size_t seg = 0; seg < n_segments; ++seg) {
+            sort_segment(array + offsets[seg], offsets[seg+1] - offsets[seg]);
+        }
+
+        return;
+    }
+
+    uint n_chunks = n_threads * SEGMENT_CHUNKS_PER_THREAD;
+
+    // Chunk c takes the segments starting in [first + total*c/n_chunks, first + total*(c+1)/n_chunks)
+    parallel_for(n_chunks, [&] (enki::TaskSetPartition range, uint32_t) {
+        for (uint c = range.start; c < range.end; ++c) {
+            size_t seg_start = find_segment(offsets, n_segments, first + total * c / n_chunks);
+            size_t seg_end   = find_segment(offsets, n_segments, first + total * (c+1) / n_chunks);
+
+            for (size_t seg = seg_start; seg < seg_end; ++seg) {
+                sort_segment(array + offsets[seg], offsets[seg+1] - offsets[seg]);
+            }
+        }
+    });
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+// lib functions
+// ---------------------------------------------------------------------------------------------------------------------
+
+static enki::TaskScheduler &get_scheduler () {
+    static enki::TaskScheduler scheduler;
+    static bool initialised = [] () {
+        scheduler.Initialize();
+        return true;
+    } ();
+
+    (void) initialised;
+    return scheduler;
+}
+
+/// Runs func over chunk indexes [0, n_chunks) and waits for completion
+static void parallel_for (uint n_chunks, const enki::TaskSetFunction &func) {
+    enki::TaskSet task(n_chunks, func);
+
+    get_scheduler().AddTaskSetToPipe(&task);
+    get_scheduler().WaitforTask(&task);
+}
+
+static uint limit_threads (size_t len, uint n_threads) {
+    size_t max_threads = len / PARALLEL_MIN_CHUNK_SIZE;
+
+    return (n_threads > max_threads) ? (uint) max_threads : n_threads;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+/// Picks up to n_splitters distinct sorted splitters from an oversampled random sample, returns their count
+static size_t choose_splitters (const int *array, size_t len, int *splitters, size_t n_splitters,
+                                sort_arena_t *arena) {
+    size_t sample_len = (n_splitters + 1) * SAMPLE_SORT_OVERSAMPLING;
+    sort_arena_mark_t mark = sort_arena_mark(arena);
+    int *sample = sort_arena_array<int>(arena, sample_len);
+
+    for (size_t i = 0; i < sample_len; ++i) {
+        sample[i] = array[(size_t) rand() % len];
+    }
+
+    qsort_median(sample, sample_len);
+
+    size_t n_unique = 0;
+    for (size_t i = 1; i <= n_splitters; ++i) {
+        int candidate = sample[i * SAMPLE_SORT_OVERSAMPLING];
+
+        if (n_unique == 0 || splitters[n_unique-1] != candidate) {
+            splitters[n_unique++] = candidate;
+        }
+    }
+
+    sort_arena_release(arena, mark);
+    return n_unique;
+}
+
+static inline uint classify (const int *splitters, size_t n_splitters, int value) {
+    const int *base = splitters;
+    size_t count = n_splitters;
+
+    // Branchless lower_bound
+    while (count > 1) {
+        size_t half = count / 2;
+        base = (base[half] < value) ? base + half : base;
+        count -= half;
+    }
+
+    size_t pos = (base - splitters) + (count == 1 && *base < value);
+
+    return (pos < n_splitters && splitters[pos] == value) ? 2 * pos + 1 : 2 * pos;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+/// Splits output into n_threads equal parts, each merged independently (merge path)
+static void merge_parallel (const int *left, size_t left_len, const int *right, size_t right_len, int *buf,
+                            uint n_threads) {
+    size_t len = left_len + right_len;
+
+    parallel_for(n_threads, [&] (enki::TaskSetPartition range, uint32_t) {
+        for (uint t = range.start; t < range.end; ++t) {
+            size_t diag_start = len * t / n_threads;
+            size_t diag_end   = len * (t+1) / n_threads;
+
+            size_t left_start = merge_path_split(left, left_len, right, right_len, diag_start);
+            size_t left_end   = merge_path_split(left, left_len, right, right_len, diag_end);
+
+            merge_stable(left + left_start, left_end - left_start,
+                         right + (diag_start - left_start), (diag_end - left_end) - (diag_start - left_start),
+                         buf + diag_start);
+        }
+    });
+}
+
+/// Returns how many elements of left are among the first diag elements of the stable merge
+static size_t merge_path_split (const int *left, size_t left_len, const int *right, size_t right_len, size_t diag) {
+    size_t lo = (diag > right_len) ? diag - right_len : 0;
+    size_t hi = (diag < left_len)  ? diag : left_len;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+
+        // On ties left goes first
+        if (left[mid] <= right[diag - mid - 1]) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+static void merge_stable (const int *left, size_t left_len, const int *right, size_t right_len, int *buf) {
+    size_t left_pos = 0;
+    size_t right_pos = 0;
+
+    while (left_pos < left_len && right_pos < right_len) {
+        if (left[left_pos] <= right[right_pos]) {
+            buf[left_pos+right_pos] = left[left_pos];
+            left_pos++;
+        } else {
+            buf[left_pos+right_pos] = right[right_pos];
+            right_pos++;
+        }
+    }
+
+    memcpy(buf + left_pos + right_pos, left + left_pos, (left_len - left_pos) * sizeof(int));
+    memcpy(buf + left_len + right_pos, right + right_pos, (right_len - right_pos) * sizeof(int));
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+/// Kernel by size: sorting network, SIMD quicksort, radix sort
+static void sort_segment (int *array, size_t len) {
+    if (len <= SEGMENT_NETWORK_MAX_SIZE) {
+        sort_network(array, len);
+    } else if (len < SEGMENT_RADIX_MIN_SIZE) {
+        qsort_simd(array, len);
+    } else {
+        radix_sort(array, len);
+    }
+}
+
+/// Index of the first segment starting at or after pos (n_segments if there is none)
+static size_t find_segment (const size_t *offsets, size_t n_segments, size_t pos) {
+    size_t lo = 0;
+    size_t hi = n_segments;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+
+        if (offsets[mid] < pos) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
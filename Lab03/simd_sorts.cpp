@@ -0,0 +1,510 @@
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include "sorts.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SIMD_X86
+#include <immintrin.h>
+#endif
+
+typedef size_t (*partition_func_t)(int *array, size_t len, int pivot);
+typedef void (*network_func_t)(int *array, size_t len);
+typedef void (*merge_func_t)(const int *left, const int *right, size_t left_len, size_t right_len, int *buf);
+
+enum simd_level_t {
+    SIMD_SCALAR,
+    SIMD_AVX2,
+    SIMD_AVX512,
+};
+
+static simd_level_t get_simd_level ();
+static partition_func_t get_partition_func ();
+static network_func_t get_network_func ();
+static merge_func_t get_merge_func ();
+static void qsort_simd_loop (int *array, size_t len, partition_func_t partition, size_t small_size,
+                             unsigned int depth_limit);
+
+static size_t partition_scalar (int *array, size_t len, int pivot);
+
+#ifdef SIMD_X86
+static void init_avx2_perm_table ();
+static size_t partition_avx2 (int *array, size_t len, int pivot);
+static size_t partition_avx512 (int *array, size_t len, int pivot);
+static void sort_network_avx2 (int *array, size_t len);
+static void merge_avx2 (const int *left, const int *right, size_t left_len, size_t right_len, int *buf);
+#endif
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+size_t partition_simd (int *array, size_t len, int pivot) {
+    return get_partition_func()(array, len, pivot);
+}
+
+void sort_network (int *array, size_t len) {
+    if (len > SORT_NETWORK_MAX_SIZE) {
+        insertion_sort_optimised(array, len);
+        return;
+    }
+
+    get_network_func()(array, len);
+}
+
+void merge_simd (const int *left, const int *right, size_t left_len, size_t right_len, int *buf) {
+    get_merge_func()(left, right, left_len, right_len, buf);
+}
+
+void qsort_simd (int *array, size_t len) {
+    qsort_simd_loop(array, len, get_partition_func(), sort_tuning().qsort_small_size,
+                    2 * (63 - __builtin_clzll(len | 1)));
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+// lib functions
+// ---------------------------------------------------------------------------------------------------------------------
+
+/// Widest instruction set the host supports (cpuid), detected once per process
+static simd_level_t get_simd_level () {
+    static simd_level_t level = [] () {
+#ifdef SIMD_X86
+        __builtin_cpu_init();
+
+        if (__builtin_cpu_supports("avx512f")) {
+            return SIMD_AVX512;
+        }
+
+        if (__builtin_cpu_supports("avx2")) {
+            return SIMD_AVX2;
+        }
+#endif
+        return SIMD_SCALAR;
+    } ();
+
+    return level;
+}
+
+static partition_func_t get_partition_func () {
+    static partition_func_t partition = [] () -> partition_func_t {
+#ifdef SIMD_X86
+        switch (get_simd_level()) {
+            case SIMD_AVX512:
+                return partition_avx512;
+            case SIMD_AVX2:
+                init_avx2_perm_table();
+                return partition_avx2;
+            default:
+                break;
+        }
+#endif
+        return partition_scalar;
+    } ();
+
+    return partition;
+}
+
+static network_func_t get_network_func () {
+#ifdef SIMD_X86
+    if (get_simd_level() >= SIMD_AVX2) {
+        return sort_network_avx2;
+    }
+#endif
+    return insertion_sort_optimised;
+}
+
+static merge_func_t get_merge_func () {
+#ifdef SIMD_X86
+    if (get_simd_level() >= SIMD_AVX2) {
+        return merge_avx2;
+    }
+#endif
+    return merge_branchless;
+}
+
+/// Slices of at most small_size are finished by the sorting network
+static void qsort_simd_loop (int *array, size_t len, partition_func_t partition, size_t small_size,
+                             unsigned int depth_limit) {
+    while (len > small_size) {
+        if (depth_limit == 0) {
+            heap_sort(array, len);
+            return;
+        }
+
+        depth_limit--;
+
+        int a = array[0], b = array[len/2], c = array[len-1];
+        int pivot = (a < b) ? ((b < c) ? b : (a < c) ? c : a)
+                            : ((a < c) ? a : (b < c) ? c : b);
+
+        size_t split = partition(array, len, pivot);
+
+        // Pivot is the minimum: split off its copies, they are already in place
+        if (split == 0) {
+            split = (pivot == INT_MAX) ? len : partition(array, len, pivot + 1);
+
+            array += split;
+            len -= split;
+            continue;
+        }
+
+        if (split < len - split) {
+            qsort_simd_loop(array, split, partition, small_size, depth_limit);
+
+            array += split;
+            len -= split;
+        } else {
+            qsort_simd_loop(array + split, len - split, partition, small_size, depth_limit);
+
+            len = split;
+        }
+    }
+
+    sort_network(array, len);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+static size_t partition_scalar (int *array, size_t len, int pivot) {
+    size_t lt_end = 0;
+
+    for (size_t i = 0; i < len; ++i) {
+        int val = array[i];
+        array[i] = array[lt_end];
+        array[lt_end] = val;
+        lt_end += (val < pivot);
+    }
+
+    return lt_end;
+}
+
+#ifdef SIMD_X86
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Vector partition
+//
+// Both kernels keep the first and the last vector in registers, so there is always at least one vector of free space
+// on each side. Every step reads from the side with less free space, writes elements < pivot to the left border and
+// the rest to the right border. The tail that does not fill a vector is placed element by element.
+// ---------------------------------------------------------------------------------------------------------------------
+
+// For every comparison mask: lanes with the bit set first, then the others
+static uint32_t avx2_perm_table[256][8];
+
+static void init_avx2_perm_table () {
+    for (uint32_t mask = 0; mask < 256; ++mask) {
+        uint32_t pos = 0;
+
+        for (uint32_t lane = 0; lane < 8; ++lane) {
+            if (mask & (1u << lane)) avx2_perm_table[mask][pos++] = lane;
+        }
+
+        for (uint32_t lane = 0; lane < 8; ++lane) {
+            if (!(mask & (1u << lane))) avx2_perm_table[mask][pos++] = lane;
+        }
+    }
+}
+
+static size_t place_tail (int *array, size_t wl, size_t wr, const int *tail, size_t tail_len, int pivot) {
+    for (size_t i = 0; i < tail_len; ++i) {
+        if (tail[i] < pivot) {
+            array[wl++] = tail[i];
+        } else {
+            array[--wr] = tail[i];
+        }
+    }
+
+    return wl;
+}
+
+__attribute__((target("avx2,popcnt")))
+static size_t partition_avx2 (int *array, size_t len, int pivot) {
+    const size_t W = 8;
+
+    if (len < 2 * W) {
+        return partition_scalar(array, len, pivot);
+    }
+
+    __m256i pivot_vec = _mm256_set1_epi32(pivot);
+    __m256i first_vec = _mm256_loadu_si256((const __m256i *) array);
+    __m256i last_vec  = _mm256_loadu_si256((const __m256i *) (array + len - W));
+
+    // Unread elements are [read_l, read_r), output goes to [0, write_l) and [write_r, len)
+    size_t read_l = W, read_r = len - W;
+    size_t write_l = 0, write_r = len;
+
+    while (read_r - read_l >= W) {
+        __m256i vec;
+
+        if (read_l - write_l <= write_r - read_r) {
+            vec = _mm256_loadu_si256((const __m256i *) (array + read_l));
+            read_l += W;
+        } else {
+            read_r -= W;
+            vec = _mm256_loadu_si256((const __m256i *) (array + read_r));
+        }
+
+        uint32_t mask = (uint32_t) _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(pivot_vec, vec)));
+        uint32_t n_less = (uint32_t) _mm_popcnt_u32(mask);
+
+        __m256i perm = _mm256_loadu_si256((const __m256i *) avx2_perm_table[mask]);
+        vec = _mm256_permutevar8x32_epi32(vec, perm);
+
+        // Extra lanes land in free space and get overwritten later
+        _mm256_storeu_si256((__m256i *) (array + write_l), vec);
+        _mm256_storeu_si256((__m256i *) (array + write_r - W), vec);
+
+        write_l += n_less;
+        write_r -= W - n_less;
+    }
+
+    int tail[3 * W];
+    size_t tail_len = read_r - read_l;
+
+    memcpy(tail, array + read_l, tail_len * sizeof(int));
+    _mm256_storeu_si256((__m256i *) (tail + tail_len), first_vec);
+    _mm256_storeu_si256((__m256i *) (tail + tail_len + W), last_vec);
+
+    return place_tail(array, write_l, write_r, tail, tail_len + 2 * W, pivot);
+}
+
+__attribute__((target("avx512f,popcnt")))
+static size_t partition_avx512 (int *array, size_t len, int pivot) {
+    const size_t W = 16;
+
+    if (len < 2 * W) {
+        return partition_scalar(array, len, pivot);
+    }
+
+    __m512i pivot_vec = _mm512_set1_epi32(pivot);
+    __m512i first_vec = _mm512_loadu_si512(array);
+    __m512i last_vec  = _mm512_loadu_si512(array + len - W);
+
+    size_t read_l = W, read_r = len - W;
+    size_t write_l = 0, write_r = len;
+
+    while (read_r - read_l >= W) {
+        __m512i vec;
+
+        if (read_l - write_l <= write_r - read_r) {
+            vec = _mm512_loadu_si512(array + read_l);
+            read_l += W;
+        } else {
+            read_r -= W;
+            vec = _mm512_loadu_si512(array + read_r);
+        }
+
+        __mmask16 mask = _mm512_cmplt_epi32_mask(vec, pivot_vec);
+        uint32_t n_less = (uint32_t) _mm_popcnt_u32(mask);
+
+        _mm512_mask_compressstoreu_epi32(array + write_l, mask, vec);
+        _mm512_mask_compressstoreu_epi32(array + write_r - (W - n_less), (__mmask16) ~mask, vec);
+
+        write_l += n_less;
+        write_r -= W - n_less;
+    }
+
+    int tail[3 * W];
+    size_t tail_len = read_r - read_l;
+
+    memcpy(tail, array + read_l, tail_len * sizeof(int));
+    _mm512_storeu_si512(tail + tail_len, first_vec);
+    _mm512_storeu_si512(tail + tail_len + W, last_vec);
+
+    return place_tail(array, write_l, write_r, tail, tail_len + 2 * W, pivot);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Sorting network
+//
+// Up to 8 registers of 8 ints. Every register is sorted on its own, then sorted groups are merged pairwise by bitonic
+// merging: reverse the second group, min/max across registers, then min/max inside registers.
+// ---------------------------------------------------------------------------------------------------------------------
+
+/// One compare-exchange stage inside a register: lanes whose blend bit is set take the max
+template<int blend>
+__attribute__((target("avx2")))
+static inline __m256i cmp_exchange_lanes (__m256i vec, __m256i partner) {
+    return _mm256_blend_epi32(_mm256_min_epi32(vec, partner), _mm256_max_epi32(vec, partner), blend);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i swap_lanes_1 (__m256i vec) {
+    return _mm256_shuffle_epi32(vec, _MM_SHUFFLE(2, 3, 0, 1));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i swap_lanes_2 (__m256i vec) {
+    return _mm256_shuffle_epi32(vec, _MM_SHUFFLE(1, 0, 3, 2));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i swap_lanes_4 (__m256i vec) {
+    return _mm256_permute2x128_si256(vec, vec, 0x01);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i reverse_lanes (__m256i vec) {
+    return _mm256_permutevar8x32_epi32(vec, _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0));
+}
+
+/// Sorts a bitonic register
+__attribute__((target("avx2")))
+static inline __m256i bitonic_merge_lanes (__m256i vec) {
+    vec = cmp_exchange_lanes<0xF0>(vec, swap_lanes_4(vec));
+    vec = cmp_exchange_lanes<0xCC>(vec, swap_lanes_2(vec));
+    vec = cmp_exchange_lanes<0xAA>(vec, swap_lanes_1(vec));
+
+    return vec;
+}
+
+__attribute__((target("avx2")))
+static inline __m256i bitonic_sort_lanes (__m256i vec) {
+    vec = cmp_exchange_lanes<0x66>(vec, swap_lanes_1(vec));
+    vec = cmp_exchange_lanes<0x3C>(vec, swap_lanes_2(vec));
+    vec = cmp_exchange_lanes<0x5A>(vec, swap_lanes_1(vec));
+
+    return bitonic_merge_lanes(vec);
+}
+
+/// Both halves of regs are sorted, merges them
+template<int n_regs>
+__attribute__((target("avx2")))
+static inline void bitonic_merge_regs (__m256i *regs) {
+    const int half = n_regs / 2;
+
+    for (int i = 0; i < half / 2; ++i) {
+        __m256i tmp = regs[half + i];
+        regs[half + i] = regs[n_regs - 1 - i];
+        regs[n_regs - 1 - i] = tmp;
+    }
+
+    for (int i = half; i < n_regs; ++i) {
+        regs[i] = reverse_lanes(regs[i]);
+    }
+
+    for (int dist = half; dist > 0; dist /= 2) {
+        for (int i = 0; i < n_regs; ++i) {
+            if (i & dist) continue;
+
+            __m256i lo = _mm256_min_epi32(regs[i], regs[i + dist]);
+            __m256i hi = _mm256_max_epi32(regs[i], regs[i + dist]);
+            regs[i] = lo;
+            regs[i + dist] = hi;
+        }
+    }
+
+    for (int i = 0; i < n_regs; ++i) {
+        regs[i] = bitonic_merge_lanes(regs[i]);
+    }
+}
+
+template<int n_regs>
+__attribute__((target("avx2")))
+static void bitonic_sort_regs (int *buf) {
+    __m256i regs[n_regs];
+
+    for (int i = 0; i < n_regs; ++i) {
+        regs[i] = bitonic_sort_lanes(_mm256_loadu_si256((const __m256i *) (buf + 8 * i)));
+    }
+
+    if (n_regs >= 2) {
+        for (int i = 0; i < n_regs; i += 2) bitonic_merge_regs<2>(regs + i);
+    }
+
+    if (n_regs >= 4) {
+        for (int i = 0; i < n_regs; i += 4) bitonic_merge_regs<4>(regs + i);
+    }
+
+    if (n_regs >= 8) {
+        bitonic_merge_regs<8>(regs);
+    }
+
+    for (int i = 0; i < n_regs; ++i) {
+        _mm256_storeu_si256((__m256i *) (buf + 8 * i), regs[i]);
+    }
+}
+
+/// Pads the input with INT_MAX up to a power of two registers
+__attribute__((target("avx2")))
+static void sort_network_avx2 (int *array, size_t len) {
+    if (len < 2) {
+        return;
+    }
+
+    int buf[SORT_NETWORK_MAX_SIZE];
+
+    memcpy(buf, array, len * sizeof(int));
+
+    size_t padded_len = 8;
+    while (padded_len < len) {
+        padded_len *= 2;
+    }
+
+    for (size_t i = len; i < padded_len; ++i) {
+        buf[i] = INT_MAX;
+    }
+
+    switch (padded_len) {
+        case 8:  bitonic_sort_regs<1>(buf); break;
+        case 16: bitonic_sort_regs<2>(buf); break;
+        case 32: bitonic_sort_regs<4>(buf); break;
+        default: bitonic_sort_regs<8>(buf); break;
+    }
+
+    memcpy(array, buf, len * sizeof(int));
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+/// Keeps the larger half of the last merge in a register and merges it with the next vector from the run whose next
+/// element is smaller. Once a run has less than a vector left, the rest is merged by the scalar kernel
+__attribute__((target("avx2")))
+static void merge_avx2 (const int *left, const int *right, size_t left_len, size_t right_len, int *buf) {
+    const size_t W = 8;
+
+    if (left_len < W || right_len < W) {
+        merge_branchless(left, right, left_len, right_len, buf);
+        return;
+    }
+
+    __m256i regs[2];
+    regs[0] = _mm256_loadu_si256((const __m256i *) left);
+    regs[1] = _mm256_loadu_si256((const __m256i *) right);
+
+    size_t left_pos = W;
+    size_t right_pos = W;
+
+    while (true) {
+        bitonic_merge_regs<2>(regs);
+
+        _mm256_storeu_si256((__m256i *) buf, regs[0]);
+        buf += W;
+        regs[0] = regs[1];
+
+        if (left_pos + W > left_len || right_pos + W > right_len) {
+            break;
+        }
+
+        if (left[left_pos] <= right[right_pos]) {
+            regs[1] = _mm256_loadu_si256((const __m256i *) (left + left_pos));
+            left_pos += W;
+        } else {
+            regs[1] = _mm256_loadu_si256((const __m256i *) (right + right_pos));
+            right_pos += W;
+        }
+    }
+
+    // Carried vector plus the short tail fit on the stack, then one scalar merge with the other tail
+    int carry[W];
+    int small[2 * W];
+    _mm256_storeu_si256((__m256i *) carry, regs[0]);
+
+    if (left_pos + W > left_len) {
+        merge_branchless(carry, left + left_pos, W, left_len - left_pos, small);
+        merge_branchless(small, right + right_pos, W + left_len - left_pos, right_len - right_pos, buf);
+    } else {
+        merge_branchless(carry, right + right_pos, W, right_len - right_pos, small);
+        merge_branchless(small, left + left_pos, W + right_len - right_pos, left_len - left_pos, buf);
+    }
+}
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef ALGO_SORT_AUTO_CALIBRATION_H
+#define ALGO_SORT_AUTO_CALIBRATION_H
+
+#include "sorts.h"
+
+// Generated by lab03 built with CALIBRATE defined, rerun it on the target host instead of editing
+
+const sort_auto_calibration_t SORT_AUTO_CALIBRATION = {
+    4096,   // radix_min_size
+    SIZE_MAX,   // radix_max_size
+    1.0000,   // counting_range_ratio
+    0.1250,   // presorted_max_ratio
+    0.1250,   // duplicate_max_ratio
+};
+
+#endif //ALGO_SORT_AUTO_CALIBRATION_H
@@ -1,13 +1,79 @@
 #include <assert.h>
 #include <string.h>
 #include <stdint.h>
+#include <stddef.h>
+#include <math.h>
 #include "sorts.h"
-
-typedef size_t (*pivot_func_t)(int *array, size_t len);
-
-static void qsort_custom (int *array, size_t len, pivot_func_t piv_func);
-
-static void merge_arrays(int *left, int *right, size_t left_len, size_t right_len, int *buf);
+#include "generic_sorts.h"
+
+
+// Block length for branchless partitioning, offsets must fit into unsigned char
+const size_t QSORT_BLOCK_SIZE = 128;
+
+static void qsort_block_loop (int *array, size_t len, size_t small_size, unsigned int depth_limit, bool leftmost);
+static size_t partition_block (int *array, size_t len);
+static size_t partition_equal_left (int *array, size_t len);
+static size_t median_of_three (const int *array, size_t a, size_t b, size_t c);
+
+// Buckets this small are finished by insertion sort
+const size_t MSD_RADIX_SMALL_SIZE = 32;
+// Smallest inputs whose LSD radix sort may use 11 and 16 bit digits, their counters would outweigh shorter ones
+const size_t RADIX_MID_DIGIT_MIN_SIZE = 1 << 16;
+const size_t RADIX_WIDE_DIGIT_MIN_SIZE = 1 << 21;
+
+static void american_flag_sort (int *array, size_t len, unsigned int shift);
+static inline unsigned int msd_digit (int value, unsigned int shift);
+
+// Evenly spaced sample taken by sample_stats, sorted by the network to count distinct values
+const size_t STATS_SAMPLE_SIZE = SORT_NETWORK_MAX_SIZE;
+
+static void counting_sort_range (int *array, size_t len, int min, size_t range, sort_arena_t *arena);
+
+template <typename T, typename U, bool is_float>
+static void radix_sort_keys (T *array, size_t len, sort_arena_t *arena);
+template <typename U, bool is_float>
+static inline U radix_key_encode (U bits);
+template <typename U, bool is_float>
+static inline U radix_key_decode (U key);
+
+typedef void (*merge_func_t)(const int *left, const int *right, size_t left_len, size_t right_len, int *buf);
+
+static void merge_arrays(const int *left, const int *right, size_t left_len, size_t right_len, int *buf);
+static void merge_sort_pingpong_rec (int *array, int *buf, size_t len, bool result_in_buf,
+                                     unsigned int optimisation_switch_size, merge_func_t merge);
+static void sort_leaf (int *array, size_t len);
+
+// Runs this short are insertion sorted, which keeps them stable
+const size_t INPLACE_MERGE_SMALL_SIZE = 16;
+
+static void merge_four (const int **heads, const int **ends, int *buf);
+static size_t drop_empty_runs (const int **heads, const int **ends, size_t n_runs);
+
+static void merge_sort_inplace_rec (int *array, size_t len, int *buf, size_t buf_len);
+static void merge_inplace (int *array, size_t left_len, size_t right_len, int *buf, size_t buf_len);
+static void rotate (int *array, size_t left_len, size_t len, int *buf, size_t buf_len);
+static void reverse (int *array, size_t len);
+static size_t lower_bound (const int *array, size_t len, int value);
+static size_t upper_bound (const int *array, size_t len, int value);
+
+// Shorter natural runs are extended to this length by insertion sort
+const size_t POWERSORT_MIN_RUN = 32;
+// Consecutive wins of one run before the merge switches to galloping
+const size_t MIN_GALLOP = 7;
+
+struct run_t {
+    size_t start;
+    size_t len;
+    unsigned int power;
+};
+
+static size_t find_run (int *array, size_t len);
+static unsigned int node_power (size_t left_start, size_t left_len, size_t right_len, size_t len);
+static void merge_runs (int *array, size_t left_len, size_t right_len, int *buf);
+static void merge_runs_lo (int *array, size_t left_len, size_t right_len, int *buf);
+static void merge_runs_hi (int *array, size_t left_len, size_t right_len, int *buf);
+template<bool upper> static size_t gallop_front (const int *array, size_t len, int key);
+template<bool upper> static size_t gallop_back (const int *array, size_t len, int key);
 static void swap (int *array, size_t i, size_t j);
 static int find_index(const int *arr, int len, int value);
 
@@ -52,16 +118,7 @@ void insertion_sort_unoptimised (int *array, size_t len) {
 }
 
 void insertion_sort_optimised (int *array, size_t len) {
-    for (size_t i = 0; i < len; ++i) {
-        size_t j = i;
-        int insert_val = array[i];
-        while (j > 0 && array[j-1] > insert_val) {
-            array[j] = array[j-1];
-            j--;
-        }
-
-        array[j] = insert_val;
-    }
+    sort<insertion_sort_t>(array, len);
 }
 
 void insertion_sort_binsearch (int *array, size_t len) {
@@ -80,75 +137,147 @@ void insertion_sort_binsearch (int *array, size_t len) {
 // ---------------------------------------------------------------------------------------------------------------------
 
 void qsort_median (int *array, size_t len) {
-    pivot_func_t pivfunc = [] (int *piv_arr, size_t piv_len) {
-        size_t max = 0;
-        size_t min = 0;
-
-        size_t mid = piv_len/2;
-        if (piv_arr[mid] < piv_arr[min])      {min = mid;}
-        else if (piv_arr[mid] > piv_arr[max]) {max = mid;}
-
-        size_t end = piv_len-1;
-        if (piv_arr[end] < piv_arr[min])      {min = end;}
-        else if (piv_arr[end] > piv_arr[max]) {max = end;}
-
-        if (max == end) {
-            return (min == 0) ? mid : 0;
-        } else if (max == mid) {
-            return (min == 0) ? max : 0;
-        } else {
-            return (min == mid) ? max : mid;
-        }
-    };
-
-    qsort_custom(array, len, pivfunc);
+    sort<quick_sort_t, pivot_median_t>(array, len);
 }
 
 // ---------------------------------------------------------------------------------------------------------------------
 
 void qsort_central (int *array, size_t len) {
-    pivot_func_t pivfunc = [] (int*, size_t piv_len) {
-       return piv_len / 2;
-    };
-
-    qsort_custom(array, len, pivfunc);
+    sort<quick_sort_t, pivot_central_t>(array, len);
 }
 
 // ---------------------------------------------------------------------------------------------------------------------
 
 void qsort_random (int *array, size_t len) {
-    pivot_func_t pivfunc = [] (int*, size_t piv_len) {
-        return (rand() % piv_len);
-    };
+    sort<quick_sort_t, pivot_random_t>(array, len);
+}
 
-    qsort_custom(array, len, pivfunc);
+void qsort_dual_pivot (int *array, size_t len) {
+    sort<dual_pivot_quick_sort_t>(array, len);
 }
 
+// ---------------------------------------------------------------------------------------------------------------------
+
+int select_kth (int *array, size_t len, size_t k) {
+    assert(k < len);
+
+    sort_select_kth(array, len, k);
+    return array[k];
+}
+
+void partial_sort (int *array, size_t len, size_t k) {
+    sort_partial(array, len, k);
+}
+
+void top_k (const int *array, size_t len, size_t k, int *out) {
+    sort_top_k(array, len, k, out);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void qsort_pivot (int *array, size_t len, pivot_strategy_t pivot) {
+    switch (pivot) {
+        case PIVOT_MEDIAN:
+            sort<quick_sort_t, pivot_median_t>(array, len);
+            break;
+        case PIVOT_CENTRAL:
+            sort<quick_sort_t, pivot_central_t>(array, len);
+            break;
+        case PIVOT_RANDOM:
+            sort<quick_sort_t, pivot_random_t>(array, len);
+            break;
+        case PIVOT_XORSHIFT:
+            sort<quick_sort_t, pivot_xorshift_t>(array, len);
+            break;
+        case PIVOT_NINTHER:
+            sort<quick_sort_t, pivot_ninther_t>(array, len);
+            break;
+        case PIVOT_SQRT_SAMPLE:
+            sort<quick_sort_t, pivot_sqrt_sample_t>(array, len);
+            break;
+        case PIVOT_MEDIAN_OF_MEDIANS:
+            sort<quick_sort_t, pivot_median_of_medians_t>(array, len);
+            break;
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+/// BlockQuicksort: partitioning compares a block of elements without branches and swaps them in bulk
+void qsort_block (int *array, size_t len) {
+    qsort_block_loop(array, len, sort_tuning().qsort_small_size, 2 * sort_log2_floor(len), true);
+}
 
 // ---------------------------------------------------------------------------------------------------------------------
 
 void radix_sort(int *const array_orig, size_t len) {
+    radix_sort(array_orig, len, radix_sort_digit_bits(len), sort_arena_local());
+}
+
+void radix_sort (int *const array_orig, size_t len, sort_arena_t *arena) {
+    radix_sort(array_orig, len, radix_sort_digit_bits(len), arena);
+}
+
+void radix_sort (int *const array_orig, size_t len, unsigned int digit_bits) {
+    radix_sort(array_orig, len, digit_bits, sort_arena_local());
+}
+
+unsigned int radix_sort_digit_bits (size_t len) {
+    unsigned int size_bits = (len >= RADIX_WIDE_DIGIT_MIN_SIZE) ? 16 : (len >= RADIX_MID_DIGIT_MIN_SIZE) ? 11 : 8;
+    unsigned int tuned_bits = sort_tuning().radix_bits;
+
+    return (tuned_bits < size_bits) ? tuned_bits : size_bits;
+}
+
+/// Histograms of every pass come from a single read, passes whose digit is the same in all keys are skipped
+void radix_sort (int *const array_orig, size_t len, unsigned int digit_bits, sort_arena_t *arena) {
+    if (len < 2) {
+        return;
+    }
+
+    const unsigned int n_passes = (32 + digit_bits - 1) / digit_bits;
+    const size_t base = (size_t) 1 << digit_bits;
+    const uint32_t mask = (uint32_t) base - 1;
+
+    sort_arena_mark_t mark = sort_arena_mark(arena);
     int *array = array_orig;
-    int *buf = (int *) calloc(len, sizeof(int));
+    int *buf = NULL;
     int *tmp_ptr;
-    uint counters[257]; // 256 bytes + 1 reserved for simpler logic
+    size_t *counters = sort_arena_array<size_t>(arena, n_passes * base);
 
-    for (uint step = 0; step < sizeof (int); ++step) {
-        memset (counters, 0, 257 * sizeof (uint));
+    memset(counters, 0, n_passes * base * sizeof(size_t));
 
-        for (uint i = 0; i < len; ++i) {
-            counters[((unsigned char *)(array + i))[step] + 1]++; // +1 => 257 надо
+    for (size_t i = 0; i < len; ++i) {
+        // Sign bit is flipped so negative values come first
+        uint32_t key = (uint32_t) array[i] ^ 0x80000000u;
+
+        for (unsigned int pass = 0; pass < n_passes; ++pass) {
+            counters[pass * base + ((key >> (pass * digit_bits)) & mask)]++;
+        }
+    }
+
+    for (unsigned int pass = 0; pass < n_passes; ++pass) {
+        size_t *counts = counters + pass * base;
+        unsigned int shift = pass * digit_bits;
+
+        if (counts[(((uint32_t) array[0] ^ 0x80000000u) >> shift) & mask] == len) {
+            continue;
+        }
+
+        if (buf == NULL) {
+            buf = sort_arena_array<int>(arena, len);
         }
 
-        assert (counters[0] == 0);
+        size_t pos = 0;
 
-        for (int i = 2; i < 256; ++i) {
-            counters[i] += counters[i-1];
+        for (size_t digit = 0; digit < base; ++digit) {
+            size_t count = counts[digit];
+            counts[digit] = pos;
+            pos += count;
         }
 
-        for (uint i = 0; i < len; ++i) {
-            buf[counters[((unsigned char *)(array + i))[step]]] = array[i];
-            counters[((unsigned char *)(array + i))[step]]++;
+        for (size_t i = 0; i < len; ++i) {
+            buf[counts[(((uint32_t) array[i] ^ 0x80000000u) >> shift) & mask]++] = array[i];
         }
 
         tmp_ptr = array;
@@ -160,57 +289,516 @@ void radix_sort(int *const array_orig, size_t len) {
         memcpy (array_orig, array, sizeof(int) * len);
     }
 
-    free(buf);
+    sort_arena_release(arena, mark);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+/// In-place MSD radix sort (American flag sort), no extra buffer
+void radix_sort_msd (int *array, size_t len) {
+    american_flag_sort(array, len, 24);
+}
+
+void radix_sort (int64_t *array, size_t len) {
+    radix_sort_keys<int64_t, uint64_t, false>(array, len, sort_arena_local());
+}
+
+void radix_sort (int64_t *array, size_t len, sort_arena_t *arena) {
+    radix_sort_keys<int64_t, uint64_t, false>(array, len, arena);
+}
+
+/// -0.0 goes before 0.0, NaNs go to the ends according to their sign bit
+void radix_sort (float *array, size_t len) {
+    radix_sort_keys<float, uint32_t, true>(array, len, sort_arena_local());
+}
+
+void radix_sort (float *array, size_t len, sort_arena_t *arena) {
+    radix_sort_keys<float, uint32_t, true>(array, len, arena);
+}
+
+void radix_sort (double *array, size_t len) {
+    radix_sort_keys<double, uint64_t, true>(array, len, sort_arena_local());
+}
+
+void radix_sort (double *array, size_t len, sort_arena_t *arena) {
+    radix_sort_keys<double, uint64_t, true>(array, len, arena);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+sample_stats_t sample_stats (const int *array, size_t len) {
+    int sample[STATS_SAMPLE_SIZE];
+    size_t size = (len < STATS_SAMPLE_SIZE) ? len : STATS_SAMPLE_SIZE;
+    sample_stats_t stats = {0, 0, 0, size, 0, 0, 0};
+    int last_direction = 0;
+
+    for (size_t i = 0; i < size; ++i) {
+        size_t pos = i * len / size;
+        sample[i] = array[pos];
+
+        if (pos + 1 < len) {
+            int direction = (array[pos] < array[pos + 1]) - (array[pos] > array[pos + 1]);
+
+            stats.ascending += (direction > 0);
+            stats.descending += (direction < 0);
+            stats.turns += (direction != 0 && last_direction != 0 && direction != last_direction);
+            last_direction = (direction != 0) ? direction : last_direction;
+        }
+    }
+
+    sort_network(sample, size);
+
+    if (size == 0) {
+        return stats;
+    }
+
+    stats.min = sample[0];
+    stats.max = sample[size - 1];
+    stats.distinct = 1;
+
+    for (size_t i = 1; i < size; ++i) {
+        stats.distinct += (sample[i] != sample[i-1]);
+    }
+
+    return stats;
+}
+
+/// The sample rejects wide ranges before the full min/max scan
+bool counting_sort_try (int *array, size_t len) {
+    return counting_sort_try(array, len, (len < COUNTING_SORT_MAX_RANGE) ? len : COUNTING_SORT_MAX_RANGE);
+}
+
+bool counting_sort_try (int *array, size_t len, size_t max_range) {
+    return counting_sort_try(array, len, max_range, sort_arena_local());
+}
+
+bool counting_sort_try (int *array, size_t len, size_t max_range, sort_arena_t *arena) {
+    if (len < 2) {
+        return true;
+    }
+
+    sample_stats_t stats = sample_stats(array, len);
+
+    if ((uint64_t) ((int64_t) stats.max - stats.min) >= max_range) {
+        return false;
+    }
+
+    int min = array[0];
+    int max = array[0];
+
+    for (size_t i = 1; i < len; ++i) {
+        min = (array[i] < min) ? array[i] : min;
+        max = (array[i] > max) ? array[i] : max;
+    }
+
+    if ((uint64_t) ((int64_t) max - min) >= max_range) {
+        return false;
+    }
+
+    counting_sort_range(array, len, min, (size_t) ((int64_t) max - min) + 1, arena);
+    return true;
+}
+
+void counting_sort (int *array, size_t len) {
+    counting_sort(array, len, sort_arena_local());
+}
+
+void counting_sort (int *array, size_t len, sort_arena_t *arena) {
+    size_t max_range = (len < COUNTING_SORT_MAX_RANGE) ? len : COUNTING_SORT_MAX_RANGE;
+
+    if (!counting_sort_try(array, len, max_range, arena)) {
+        radix_sort(array, len, arena);
+    }
 }
 
 // ---------------------------------------------------------------------------------------------------------------------
 // lib functions
 // ---------------------------------------------------------------------------------------------------------------------
 
-static void qsort_custom (int *array, size_t len, pivot_func_t piv_func) {
-    int *const base_p = array;
+/// Slices of at most small_size are finished by the sorting network
+static void qsort_block_loop (int *array, size_t len, size_t small_size, unsigned int depth_limit, bool leftmost) {
+    while (len > small_size) {
+        if (depth_limit == 0) {
+            heap_sort(array, len);
+            return;
+        }
 
-    // Small array optimisations
-    if (len == 1) { return; }
-    else if (len == 2) {
-        if (array[0] > array[1]) {
-            swap(array, 0, 1);
+        depth_limit--;
+
+        swap(array, 0, median_of_three(array, 0, len/2, len-1));
+
+        // array[-1] is not greater than anything here, so if it equals the pivot the pivot is the minimum
+        if (!leftmost && array[-1] == array[0]) {
+            size_t eq_end = partition_equal_left(array, len);
+
+            array += eq_end;
+            len -= eq_end;
+            continue;
+        }
+
+        size_t split = partition_block(array, len);
+        size_t right_len = len - split - 1;
+
+        if (split < right_len) {
+            qsort_block_loop(array, split, small_size, depth_limit, leftmost);
+
+            array += split + 1;
+            len = right_len;
+            leftmost = false;
+        } else {
+            qsort_block_loop(array + split + 1, right_len, small_size, depth_limit, false);
+
+            len = split;
         }
+    }
+
+    sort_network(array, len);
+}
+
+/// Pivot is array[0]. Afterwards [0, split) < pivot == array[split] <= [split+1, len)
+static size_t partition_block (int *array, size_t len) {
+    int pivot = array[0];
+
+    int *first = array + 1;
+    int *last  = array + len;
+
+    unsigned char offsets_l[QSORT_BLOCK_SIZE];
+    unsigned char offsets_r[QSORT_BLOCK_SIZE];
+
+    size_t num_l = 0, start_l = 0;
+    size_t num_r = 0, start_r = 0;
+
+    while (last - first > (ptrdiff_t) (2 * QSORT_BLOCK_SIZE)) {
+        if (num_l == 0) {
+            start_l = 0;
+            for (size_t i = 0; i < QSORT_BLOCK_SIZE; ++i) {
+                offsets_l[num_l] = (unsigned char) i;
+                num_l += !(first[i] < pivot);
+            }
+        }
+
+        if (num_r == 0) {
+            start_r = 0;
+            for (size_t i = 0; i < QSORT_BLOCK_SIZE; ++i) {
+                offsets_r[num_r] = (unsigned char) i;
+                num_r += (last[-1 - (ptrdiff_t) i] < pivot);
+            }
+        }
+
+        size_t num = (num_l < num_r) ? num_l : num_r;
+        for (size_t i = 0; i < num; ++i) {
+            int *lhs = first + offsets_l[start_l + i];
+            int *rhs = last - 1 - offsets_r[start_r + i];
+
+            int tmp = *lhs;
+            *lhs = *rhs;
+            *rhs = tmp;
+        }
+
+        num_l -= num;
+        num_r -= num;
+        start_l += num;
+        start_r += num;
+
+        if (num_l == 0) first += QSORT_BLOCK_SIZE;
+        if (num_r == 0) last  -= QSORT_BLOCK_SIZE;
+    }
+
+    // At most one pending block is left, split the rest between the sides
+    size_t unknown = (last - first) - ((num_l || num_r) ? QSORT_BLOCK_SIZE : 0);
+    size_t l_size = 0;
+    size_t r_size = 0;
+
+    if (num_r) {
+        l_size = unknown;
+        r_size = QSORT_BLOCK_SIZE;
+    } else if (num_l) {
+        l_size = QSORT_BLOCK_SIZE;
+        r_size = unknown;
+    } else {
+        l_size = unknown / 2;
+        r_size = unknown - l_size;
+    }
+
+    if (unknown && num_l == 0) {
+        start_l = 0;
+        for (size_t i = 0; i < l_size; ++i) {
+            offsets_l[num_l] = (unsigned char) i;
+            num_l += !(first[i] < pivot);
+        }
+    }
+
+    if (unknown && num_r == 0) {
+        start_r = 0;
+        for (size_t i = 0; i < r_size; ++i) {
+            offsets_r[num_r] = (unsigned char) i;
+            num_r += (last[-1 - (ptrdiff_t) i] < pivot);
+        }
+    }
+
+    size_t num = (num_l < num_r) ? num_l : num_r;
+    for (size_t i = 0; i < num; ++i) {
+        int *lhs = first + offsets_l[start_l + i];
+        int *rhs = last - 1 - offsets_r[start_r + i];
+
+        int tmp = *lhs;
+        *lhs = *rhs;
+        *rhs = tmp;
+    }
+
+    num_l -= num;
+    num_r -= num;
+    start_l += num;
+    start_r += num;
+
+    if (num_l == 0) first += l_size;
+    if (num_r == 0) last  -= r_size;
+
+    // Only one side can still have misplaced elements, move them to the border
+    if (num_l) {
+        while (num_l--) {
+            last--;
+            int tmp = first[offsets_l[start_l + num_l]];
+            first[offsets_l[start_l + num_l]] = *last;
+            *last = tmp;
+        }
+        first = last;
+    }
+
+    if (num_r) {
+        while (num_r--) {
+            int tmp = last[-1 - (ptrdiff_t) offsets_r[start_r + num_r]];
+            last[-1 - (ptrdiff_t) offsets_r[start_r + num_r]] = *first;
+            *first = tmp;
+            first++;
+        }
+    }
+
+    size_t split = (first - array) - 1;
+    swap(array, 0, split);
+
+    return split;
+}
+
+/// Pivot is array[0] and nothing is less than it. Moves copies of the pivot to the front, returns their count
+static size_t partition_equal_left (int *array, size_t len) {
+    int pivot = array[0];
+    size_t eq_end = 0;
+
+    for (size_t i = 0; i < len; ++i) {
+        int val = array[i];
+        array[i] = array[eq_end];
+        array[eq_end] = val;
+        eq_end += (val == pivot);
+    }
+
+    return eq_end;
+}
+
+static size_t median_of_three (const int *array, size_t a, size_t b, size_t c) {
+    if (array[a] < array[b]) {
+        if (array[b] < array[c]) return b;
+        return (array[a] < array[c]) ? c : a;
+    } else {
+        if (array[a] < array[c]) return a;
+        return (array[b] < array[c]) ? c : b;
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+static void american_flag_sort (int *array, size_t len, unsigned int shift) {
+    if (len <= MSD_RADIX_SMALL_SIZE) {
+        insertion_sort_optimised(array, len);
         return;
     }
 
-    // Regular algorithm
+    size_t counts[RADIX_BASE] = {};
 
-    size_t lo = 0;
-    size_t hi = len - 1;
-    size_t pi = piv_func(array, len);
+    for (size_t i = 0; i < len; ++i) {
+        counts[msd_digit(array[i], shift)]++;
+    }
+
+    size_t heads[RADIX_BASE];
+    size_t tails[RADIX_BASE];
+    size_t pos = 0;
+    bool single_bucket = false;
 
-    while (hi > lo) {
-        while (array[lo] < array[pi] && lo < len) lo++;
-        while (array[hi] > array[pi] && hi > 0)   hi--;
+    for (unsigned int digit = 0; digit < RADIX_BASE; ++digit) {
+        heads[digit] = pos;
+        pos += counts[digit];
+        tails[digit] = pos;
+
+        single_bucket |= (counts[digit] == len);
+    }
 
-        if (lo < hi) {
-            swap (array, lo, hi);
+    // Cycle leader: carry the displaced element to its bucket until one that belongs here comes back
+    if (!single_bucket) {
+        for (unsigned int digit = 0; digit < RADIX_BASE; ++digit) {
+            while (heads[digit] < tails[digit]) {
+                int val = array[heads[digit]];
+                unsigned int val_digit = msd_digit(val, shift);
 
-            if (pi == lo) pi = hi;
-            else if (pi == hi) pi = lo;
+                while (val_digit != digit) {
+                    int tmp = array[heads[val_digit]];
+                    array[heads[val_digit]++] = val;
 
-            lo++;
-            hi--;
+                    val = tmp;
+                    val_digit = msd_digit(val, shift);
+                }
+
+                array[heads[digit]++] = val;
+            }
         }
     }
 
-    if (hi > 0) {
-        qsort_custom (base_p, hi + 1, piv_func);
+    if (shift == 0) {
+        return;
     }
 
-    if (lo < len - 1) {
-        qsort_custom(base_p + lo, len - lo, piv_func);
+    size_t start = 0;
+
+    for (unsigned int digit = 0; digit < RADIX_BASE; start += counts[digit], ++digit) {
+        if (counts[digit] > 1) {
+            american_flag_sort(array + start, counts[digit], shift - 8);
+        }
+    }
+}
+
+/// Sign bit is flipped so negative values come first
+static inline unsigned int msd_digit (int value, unsigned int shift) {
+    return (((unsigned int) value ^ 0x80000000u) >> shift) & (RADIX_BASE - 1);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+/// Every value lies in [min, min + range)
+static void counting_sort_range (int *array, size_t len, int min, size_t range, sort_arena_t *arena) {
+    sort_arena_mark_t mark = sort_arena_mark(arena);
+    size_t *counts = sort_arena_array<size_t>(arena, range);
+
+    memset(counts, 0, range * sizeof(size_t));
+
+    for (size_t i = 0; i < len; ++i) {
+        counts[(size_t) ((int64_t) array[i] - min)]++;
+    }
+
+    size_t pos = 0;
+
+    for (size_t value = 0; value < range; ++value) {
+        int fill = (int) ((int64_t) min + (int64_t) value);
+
+        for (size_t end = pos + counts[value]; pos < end; ++pos) {
+            array[pos] = fill;
+        }
+    }
+
+    sort_arena_release(arena, mark);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+/// LSD radix sort of T through unsigned keys U whose order matches the order of T
+template <typename T, typename U, bool is_float>
+static void radix_sort_keys (T *array, size_t len, sort_arena_t *arena) {
+    static_assert(sizeof(T) == sizeof(U), "key must be as wide as the value");
+
+    if (len < 2) {
+        return;
+    }
+
+    sort_arena_mark_t mark = sort_arena_mark(arena);
+    U *keys = sort_arena_array<U>(arena, len);
+    U *buf = sort_arena_array<U>(arena, len);
+    size_t (*counters)[RADIX_BASE] = (size_t (*)[RADIX_BASE]) sort_arena_alloc(arena, sizeof(U) * sizeof(*counters));
+
+    memset(counters, 0, sizeof(U) * sizeof(*counters));
+
+    // Histograms of every digit are built in the same read that encodes the keys
+    for (size_t i = 0; i < len; ++i) {
+        U bits;
+        memcpy(&bits, array + i, sizeof(U));
+        keys[i] = radix_key_encode<U, is_float>(bits);
+
+        for (unsigned int step = 0; step < sizeof(U); ++step) {
+            counters[step][(keys[i] >> (step * 8)) & (RADIX_BASE - 1)]++;
+        }
+    }
+
+    for (unsigned int step = 0; step < sizeof(U); ++step) {
+        size_t *counts = counters[step];
+
+        // Every key has the same digit here, the pass would only copy
+        if (counts[(keys[0] >> (step * 8)) & (RADIX_BASE - 1)] == len) {
+            continue;
+        }
+
+        size_t pos = 0;
+
+        for (unsigned int digit = 0; digit < RADIX_BASE; ++digit) {
+            size_t count = counts[digit];
+            counts[digit] = pos;
+            pos += count;
+        }
+
+        for (size_t i = 0; i < len; ++i) {
+            buf[counts[(keys[i] >> (step * 8)) & (RADIX_BASE - 1)]++] = keys[i];
+        }
+
+        U *tmp = keys;
+        keys = buf;
+        buf = tmp;
+    }
+
+    for (size_t i = 0; i < len; ++i) {
+        U bits = radix_key_decode<U, is_float>(keys[i]);
+        memcpy(array + i, &bits, sizeof(U));
     }
+
+    sort_arena_release(arena, mark);
+}
+
+/// Flips the sign bit, negative floats are inverted entirely since their magnitude grows the other way
+template <typename U, bool is_float>
+static inline U radix_key_encode (U bits) {
+    const U sign = (U) 1 << (sizeof(U) * 8 - 1);
+
+    if (is_float && (bits & sign)) {
+        return ~bits;
+    }
+
+    return bits ^ sign;
+}
+
+template <typename U, bool is_float>
+static inline U radix_key_decode (U key) {
+    const U sign = (U) 1 << (sizeof(U) * 8 - 1);
+
+    if (is_float && !(key & sign)) {
+        return ~key;
+    }
+
+    return key ^ sign;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void heap_sort (int *array, size_t len) {
+    sort<heap_sort_t>(array, len);
 }
 
 // ---------------------------------------------------------------------------------------------------------------------
 
+void merge_sort (int *array, size_t len) {
+    merge_sort(array, len, sort_arena_local());
+}
+
+void merge_sort (int *array, size_t len, sort_arena_t *arena) {
+    sort_arena_mark_t mark = sort_arena_mark(arena);
+    merge_sort(array, len, sort_arena_array<int>(arena, len), sort_tuning().merge_small_size);
+    sort_arena_release(arena, mark);
+}
+
 void merge_sort (int *array, size_t len, int *buf, unsigned int optimisation_switch_size) {
     if (len == 1) { return; }
 
@@ -223,7 +811,7 @@ void merge_sort (int *array, size_t len, int *buf, unsigned int optimisation_swi
     }
 
     if (len <= optimisation_switch_size) {
-        insertion_sort_optimised(array, len);
+        sort_leaf(array, len);
         return;
     }
 
@@ -235,7 +823,585 @@ void merge_sort (int *array, size_t len, int *buf, unsigned int optimisation_swi
     memcpy(array, buf, len * sizeof(int));
 }
 
-static void merge_arrays(int *left, int *right, size_t left_len, size_t right_len, int *buf) {
+// ---------------------------------------------------------------------------------------------------------------------
+
+void merge_sort_pingpong (int *array, size_t len, int *buf, unsigned int optimisation_switch_size,
+                          merge_kernel_t kernel) {
+    merge_func_t merge = merge_arrays;
+
+    if (kernel == MERGE_BRANCHLESS) {
+        merge = merge_branchless;
+    } else if (kernel == MERGE_SIMD) {
+        merge = merge_simd;
+    }
+
+    merge_sort_pingpong_rec(array, buf, len, false, optimisation_switch_size, merge);
+}
+
+/// Children leave their halves in the other buffer, so each level merges straight into its destination
+static void merge_sort_pingpong_rec (int *array, int *buf, size_t len, bool result_in_buf,
+                                     unsigned int optimisation_switch_size, merge_func_t merge) {
+    if (len <= optimisation_switch_size || len < 2) {
+        sort_leaf(array, len);
+
+        if (result_in_buf) {
+            memcpy(buf, array, len * sizeof(int));
+        }
+
+        return;
+    }
+
+    size_t half = len/2;
+    merge_sort_pingpong_rec(array, buf, half, !result_in_buf, optimisation_switch_size, merge);
+    merge_sort_pingpong_rec(array + half, buf + half, len - half, !result_in_buf, optimisation_switch_size, merge);
+
+    if (result_in_buf) {
+        merge(array, array + half, half, len - half, buf);
+    } else {
+        merge(buf, buf + half, half, len - half, array);
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void merge_sort_bottom_up (int *array, size_t len, int *buf, size_t run_len) {
+    if (run_len == 0) {
+        run_len = 1;
+    }
+
+    for (size_t start = 0; start < len; start += run_len) {
+        size_t count = (len - start < run_len) ? len - start : run_len;
+        merge_sort_pingpong(array + start, count, buf + start, SORT_NETWORK_MAX_SIZE, MERGE_SIMD);
+    }
+
+    int *src = array;
+    int *dst = buf;
+
+    // Every pass merges 4 runs, so DRAM is streamed log4(len / run_len) times
+    for (size_t width = run_len; width < len; width *= 4) {
+        for (size_t start = 0; start < len; start += 4 * width) {
+            const int *heads[4];
+            const int *ends[4];
+
+            for (size_t run = 0; run < 4; ++run) {
+                size_t run_start = start + run * width;
+                size_t run_end   = run_start + width;
+
+                if (run_start > len) run_start = len;
+                if (run_end > len)   run_end = len;
+
+                heads[run] = src + run_start;
+                ends[run]  = src + run_end;
+            }
+
+            merge_four(heads, ends, dst + start);
+        }
+
+        int *tmp = src;
+        src = dst;
+        dst = tmp;
+    }
+
+    if (src != array) {
+        memcpy(array, src, len * sizeof(int));
+    }
+}
+
+/// Runs may be empty. Between exhaustion checks every run can give min(remaining) elements without bounds checks
+static void merge_four (const int **heads, const int **ends, int *buf) {
+    size_t n_runs = drop_empty_runs(heads, ends, 4);
+
+    while (n_runs == 4) {
+        size_t safe_count = ends[0] - heads[0];
+        for (size_t run = 1; run < 4; ++run) {
+            if ((size_t) (ends[run] - heads[run]) < safe_count) {
+                safe_count = ends[run] - heads[run];
+            }
+        }
+
+        for (size_t i = 0; i < safe_count; ++i) {
+            const int **left  = (*heads[1] < *heads[0]) ? &heads[1] : &heads[0];
+            const int **right = (*heads[3] < *heads[2]) ? &heads[3] : &heads[2];
+            const int **min   = (**right < **left) ? right : left;
+
+            *buf++ = *(*min)++;
+        }
+
+        n_runs = drop_empty_runs(heads, ends, n_runs);
+    }
+
+    while (n_runs == 3) {
+        size_t safe_count = ends[0] - heads[0];
+        for (size_t run = 1; run < 3; ++run) {
+            if ((size_t) (ends[run] - heads[run]) < safe_count) {
+                safe_count = ends[run] - heads[run];
+            }
+        }
+
+        for (size_t i = 0; i < safe_count; ++i) {
+            const int **left = (*heads[1] < *heads[0]) ? &heads[1] : &heads[0];
+            const int **min  = (*heads[2] < **left) ? &heads[2] : left;
+
+            *buf++ = *(*min)++;
+        }
+
+        n_runs = drop_empty_runs(heads, ends, n_runs);
+    }
+
+    if (n_runs == 2) {
+        merge_branchless(heads[0], heads[1], ends[0] - heads[0], ends[1] - heads[1], buf);
+    } else if (n_runs == 1) {
+        memcpy(buf, heads[0], (ends[0] - heads[0]) * sizeof(int));
+    }
+}
+
+/// Keeps the order of the remaining runs, returns their count
+static size_t drop_empty_runs (const int **heads, const int **ends, size_t n_runs) {
+    size_t n_left = 0;
+
+    for (size_t run = 0; run < n_runs; ++run) {
+        if (heads[run] != ends[run]) {
+            heads[n_left] = heads[run];
+            ends[n_left]  = ends[run];
+            n_left++;
+        }
+    }
+
+    return n_left;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void powersort (int *array, size_t len) {
+    powersort(array, len, sort_arena_local());
+}
+
+/// Natural merge sort: merges ascending/descending runs in the order chosen by the powersort node powers
+void powersort (int *array, size_t len, sort_arena_t *arena) {
+    if (len < 2) {
+        return;
+    }
+
+    sort_arena_mark_t mark = sort_arena_mark(arena);
+    int *buf = sort_arena_array<int>(arena, len / 2 + 1);
+
+    // Node powers strictly grow from the bottom of the stack, so it never holds more than ~64 runs
+    run_t stack[2 * sizeof(size_t) * 8];
+    size_t stack_size = 0;
+
+    for (size_t start = 0; start < len; ) {
+        size_t run_len = find_run(array + start, len - start);
+
+        if (run_len < POWERSORT_MIN_RUN) {
+            run_len = (len - start < POWERSORT_MIN_RUN) ? len - start : POWERSORT_MIN_RUN;
+            insertion_sort_optimised(array + start, run_len);
+        }
+
+        if (stack_size > 0) {
+            run_t *top = &stack[stack_size-1];
+            unsigned int power = node_power(top->start, top->len, run_len, len);
+
+            while (stack_size > 1 && stack[stack_size-2].power > power) {
+                run_t *left  = &stack[stack_size-2];
+                run_t *right = &stack[stack_size-1];
+
+                merge_runs(array + left->start, left->len, right->len, buf);
+                left->len += right->len;
+                stack_size--;
+            }
+
+            stack[stack_size-1].power = power;
+        }
+
+        stack[stack_size++] = {start, run_len, 0};
+        start += run_len;
+    }
+
+    while (stack_size > 1) {
+        run_t *left  = &stack[stack_size-2];
+        run_t *right = &stack[stack_size-1];
+
+        merge_runs(array + left->start, left->len, right->len, buf);
+        left->len += right->len;
+        stack_size--;
+    }
+
+    sort_arena_release(arena, mark);
+}
+
+/// Returns the length of the run at the start, strictly descending runs are reversed in place
+static size_t find_run (int *array, size_t len) {
+    if (len < 2) {
+        return len;
+    }
+
+    size_t end = 2;
+
+    if (array[1] < array[0]) {
+        while (end < len && array[end] < array[end-1]) end++;
+        reverse(array, end);
+    } else {
+        while (end < len && array[end] >= array[end-1]) end++;
+    }
+
+    return end;
+}
+
+/// Depth of the boundary between two runs in the ideal merge tree over [0, len)
+static unsigned int node_power (size_t left_start, size_t left_len, size_t right_len, size_t len) {
+    // Doubled midpoints of both runs, compared bit by bit as fractions of len
+    size_t left_mid  = 2 * left_start + left_len;
+    size_t right_mid = left_mid + left_len + right_len;
+    unsigned int power = 0;
+
+    while (true) {
+        power++;
+
+        if (left_mid >= len) {
+            left_mid  -= len;
+            right_mid -= len;
+        } else if (right_mid >= len) {
+            break;
+        }
+
+        left_mid  <<= 1;
+        right_mid <<= 1;
+    }
+
+    return power;
+}
+
+/// Trims the parts that are already in place, then merges through buf from the shorter side
+static void merge_runs (int *array, size_t left_len, size_t right_len, int *buf) {
+    int *right = array + left_len;
+
+    // Left elements <= right[0] stay where they are
+    size_t skip = gallop_front<true>(array, left_len, right[0]);
+    array += skip;
+    left_len -= skip;
+
+    if (left_len == 0) {
+        return;
+    }
+
+    // Right elements >= the last left element stay too
+    right_len = gallop_back<false>(right, right_len, array[left_len-1]);
+
+    if (left_len <= right_len) {
+        merge_runs_lo(array, left_len, right_len, buf);
+    } else {
+        merge_runs_hi(array, left_len, right_len, buf);
+    }
+}
+
+/// Left run goes to buf, output is written from the front
+static void merge_runs_lo (int *array, size_t left_len, size_t right_len, int *buf) {
+    memcpy(buf, array, left_len * sizeof(int));
+
+    int *right = array + left_len;
+    size_t left_pos = 0, right_pos = 0;
+    int *out = array;
+
+    while (left_pos < left_len && right_pos < right_len) {
+        size_t left_wins = 0;
+        size_t right_wins = 0;
+
+        do {
+            if (right[right_pos] < buf[left_pos]) {
+                *out++ = right[right_pos++];
+                right_wins++;
+                left_wins = 0;
+            } else {
+                *out++ = buf[left_pos++];
+                left_wins++;
+                right_wins = 0;
+            }
+        } while (left_pos < left_len && right_pos < right_len && left_wins < MIN_GALLOP && right_wins < MIN_GALLOP);
+
+        // One side keeps winning: copy whole blocks found by exponential search
+        while (left_pos < left_len && right_pos < right_len) {
+            size_t left_count = gallop_front<true>(buf + left_pos, left_len - left_pos, right[right_pos]);
+            memcpy(out, buf + left_pos, left_count * sizeof(int));
+            out += left_count;
+            left_pos += left_count;
+
+            if (left_pos == left_len) {
+                break;
+            }
+
+            size_t right_count = gallop_front<false>(right + right_pos, right_len - right_pos, buf[left_pos]);
+            memmove(out, right + right_pos, right_count * sizeof(int));
+            out += right_count;
+            right_pos += right_count;
+
+            if (left_count < MIN_GALLOP && right_count < MIN_GALLOP) {
+                break;
+            }
+        }
+    }
+
+    // Right leftovers are already in place
+    memcpy(out, buf + left_pos, (left_len - left_pos) * sizeof(int));
+}
+
+/// Right run goes to buf, output is written from the back
+static void merge_runs_hi (int *array, size_t left_len, size_t right_len, int *buf) {
+    memcpy(buf, array + left_len, right_len * sizeof(int));
+
+    size_t left_pos = left_len, right_pos = right_len;
+    int *out = array + left_len + right_len;
+
+    while (left_pos > 0 && right_pos > 0) {
+        size_t left_wins = 0;
+        size_t right_wins = 0;
+
+        do {
+            if (buf[right_pos-1] < array[left_pos-1]) {
+                *--out = array[--left_pos];
+                left_wins++;
+                right_wins = 0;
+            } else {
+                *--out = buf[--right_pos];
+                right_wins++;
+                left_wins = 0;
+            }
+        } while (left_pos > 0 && right_pos > 0 && left_wins < MIN_GALLOP && right_wins < MIN_GALLOP);
+
+        while (left_pos > 0 && right_pos > 0) {
+            size_t right_start = gallop_back<false>(buf, right_pos, array[left_pos-1]);
+            size_t right_count = right_pos - right_start;
+            out -= right_count;
+            memcpy(out, buf + right_start, right_count * sizeof(int));
+            right_pos = right_start;
+
+            if (right_pos == 0) {
+                break;
+            }
+
+            size_t left_start = gallop_back<true>(array, left_pos, buf[right_pos-1]);
+            size_t left_count = left_pos - left_start;
+            out -= left_count;
+            memmove(out, array + left_start, left_count * sizeof(int));
+            left_pos = left_start;
+
+            if (left_count < MIN_GALLOP && right_count < MIN_GALLOP) {
+                break;
+            }
+        }
+    }
+
+    // Left leftovers are already in place
+    memcpy(array, buf, right_pos * sizeof(int));
+}
+
+/// First position with array[pos] > key (upper) or >= key (lower), probing 1, 2, 4... elements from the front
+template<bool upper>
+static size_t gallop_front (const int *array, size_t len, int key) {
+    size_t lo = 0;
+    size_t step = 1;
+
+    while (lo + step <= len && (upper ? array[lo + step - 1] <= key : array[lo + step - 1] < key)) {
+        lo += step;
+        step *= 2;
+    }
+
+    size_t hi = (lo + step - 1 < len) ? lo + step - 1 : len;
+
+    return lo + (upper ? upper_bound(array + lo, hi - lo, key) : lower_bound(array + lo, hi - lo, key));
+}
+
+/// Same as gallop_front, but probes from the back
+template<bool upper>
+static size_t gallop_back (const int *array, size_t len, int key) {
+    size_t hi = len;
+    size_t step = 1;
+
+    while (hi >= step && (upper ? array[hi - step] > key : array[hi - step] >= key)) {
+        hi -= step;
+        step *= 2;
+    }
+
+    size_t lo = (hi >= step) ? hi - step + 1 : 0;
+
+    return lo + (upper ? upper_bound(array + lo, hi - lo, key) : lower_bound(array + lo, hi - lo, key));
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void merge_sort_inplace (int *array, size_t len) {
+    merge_sort_inplace(array, len, (size_t) sqrt((double) len) * sizeof(int));
+}
+
+void merge_sort_inplace (int *array, size_t len, size_t mem_budget) {
+    merge_sort_inplace(array, len, mem_budget, sort_arena_local());
+}
+
+void merge_sort_inplace (int *array, size_t len, size_t mem_budget, sort_arena_t *arena) {
+    size_t buf_len = mem_budget / sizeof(int);
+
+    // Merges never need more than the smaller half
+    if (buf_len > len / 2) {
+        buf_len = len / 2;
+    }
+
+    sort_arena_mark_t mark = sort_arena_mark(arena);
+    int *buf = (buf_len > 0) ? sort_arena_array<int>(arena, buf_len) : NULL;
+
+    merge_sort_inplace_rec(array, len, buf, buf_len);
+
+    sort_arena_release(arena, mark);
+}
+
+static void merge_sort_inplace_rec (int *array, size_t len, int *buf, size_t buf_len) {
+    if (len <= INPLACE_MERGE_SMALL_SIZE) {
+        insertion_sort_optimised(array, len);
+        return;
+    }
+
+    size_t half = len/2;
+    merge_sort_inplace_rec(array, half, buf, buf_len);
+    merge_sort_inplace_rec(array + half, len - half, buf, buf_len);
+
+    merge_inplace(array, half, len - half, buf, buf_len);
+}
+
+/// Buffered merge when one run fits into buf, otherwise splits both runs around a pivot and rotates the middle
+static void merge_inplace (int *array, size_t left_len, size_t right_len, int *buf, size_t buf_len) {
+    if (left_len == 0 || right_len == 0 || array[left_len-1] <= array[left_len]) {
+        return;
+    }
+
+    int *right = array + left_len;
+
+    if (left_len <= buf_len) {
+        memcpy(buf, array, left_len * sizeof(int));
+
+        size_t left_pos = 0, right_pos = 0, out = 0;
+        while (left_pos < left_len && right_pos < right_len) {
+            if (buf[left_pos] <= right[right_pos]) {
+                array[out++] = buf[left_pos++];
+            } else {
+                array[out++] = right[right_pos++];
+            }
+        }
+
+        memcpy(array + out, buf + left_pos, (left_len - left_pos) * sizeof(int));
+        return;
+    }
+
+    if (right_len <= buf_len) {
+        memcpy(buf, right, right_len * sizeof(int));
+
+        size_t left_pos = left_len, right_pos = right_len, out = left_len + right_len;
+        while (left_pos > 0 && right_pos > 0) {
+            if (buf[right_pos-1] < array[left_pos-1]) {
+                array[--out] = array[--left_pos];
+            } else {
+                array[--out] = buf[--right_pos];
+            }
+        }
+
+        memcpy(array, buf, right_pos * sizeof(int));
+        return;
+    }
+
+    if (left_len == 1 && right_len == 1) {
+        swap(array, 0, 1);
+        return;
+    }
+
+    size_t left_cut = 0;
+    size_t right_cut = 0;
+
+    if (left_len > right_len) {
+        left_cut  = left_len / 2;
+        right_cut = lower_bound(right, right_len, array[left_cut]);
+    } else {
+        right_cut = right_len / 2;
+        left_cut  = upper_bound(array, left_len, right[right_cut]);
+    }
+
+    rotate(array + left_cut, left_len - left_cut, (left_len - left_cut) + right_cut, buf, buf_len);
+
+    size_t mid = left_cut + right_cut;
+    merge_inplace(array, left_cut, right_cut, buf, buf_len);
+    merge_inplace(array + mid, left_len - left_cut, right_len - right_cut, buf, buf_len);
+}
+
+/// Swaps [0, left_len) and [left_len, len)
+static void rotate (int *array, size_t left_len, size_t len, int *buf, size_t buf_len) {
+    size_t right_len = len - left_len;
+
+    if (left_len == 0 || right_len == 0) {
+        return;
+    }
+
+    if (left_len <= buf_len) {
+        memcpy(buf, array, left_len * sizeof(int));
+        memmove(array, array + left_len, right_len * sizeof(int));
+        memcpy(array + right_len, buf, left_len * sizeof(int));
+    } else if (right_len <= buf_len) {
+        memcpy(buf, array + left_len, right_len * sizeof(int));
+        memmove(array + right_len, array, left_len * sizeof(int));
+        memcpy(array, buf, right_len * sizeof(int));
+    } else {
+        reverse(array, left_len);
+        reverse(array + left_len, right_len);
+        reverse(array, len);
+    }
+}
+
+static void reverse (int *array, size_t len) {
+    for (size_t i = 0; i < len / 2; ++i) {
+        swap(array, i, len - 1 - i);
+    }
+}
+
+/// First position with array[pos] >= value
+static size_t lower_bound (const int *array, size_t len, int value) {
+    size_t lo = 0;
+    size_t hi = len;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+
+        if (array[mid] < value) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+/// First position with array[pos] > value
+static size_t upper_bound (const int *array, size_t len, int value) {
+    size_t lo = 0;
+    size_t hi = len;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+
+        if (array[mid] <= value) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+static void sort_leaf (int *array, size_t len) {
+    if (len <= SORT_NETWORK_MAX_SIZE) {
+        sort_network(array, len);
+    } else {
+        insertion_sort_optimised(array, len);
+    }
+}
+
+static void merge_arrays(const int *left, const int *right, size_t left_len, size_t right_len, int *buf) {
     size_t left_pos = 0;
     size_t right_pos = 0;
 
@@ -260,6 +1426,23 @@ static void merge_arrays(int *left, int *right, size_t left_len, size_t right_le
     }
 }
 
+/// Picks the next element with a conditional move instead of a branch
+void merge_branchless (const int *left, const int *right, size_t left_len, size_t right_len, int *buf) {
+    const int *left_end  = left + left_len;
+    const int *right_end = right + right_len;
+
+    while (left < left_end && right < right_end) {
+        bool take_left = (*left <= *right);
+
+        *buf++ = take_left ? *left : *right;
+        left  += take_left;
+        right += !take_left;
+    }
+
+    memcpy(buf, left, (left_end - left) * sizeof(int));
+    memcpy(buf + (left_end - left), right, (right_end - right) * sizeof(int));
+}
+
 
 // ---------------------------------------------------------------------------------------------------------------------
 
@@ -288,4 +1471,4 @@ static int find_index(const int *arr, int len, int value) {
     }
     // Return insert position
     return end + 1;
-}
\ No newline at end of file
+}
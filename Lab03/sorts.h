@@ -2,9 +2,52 @@
 #define ALGO_SORTS_H
 
 #include <stdlib.h>
+#include <stdint.h>
 
 typedef void (*sort_func_t)(int* array, size_t len);
 
+// ---------------------------------------------------------------------------------------------------------------------
+// Scratch arena
+// ---------------------------------------------------------------------------------------------------------------------
+
+const size_t SORT_ARENA_ALIGN = 64;
+
+struct sort_arena_block_t;
+
+/// Bump allocator for sort scratch. Blocks outlive the sort that asked for them, so repeated sorts stop paying for
+/// malloc, calloc zeroing and page faults. Every buffer-needing sort takes one, the overloads without it use
+/// sort_arena_local()
+struct sort_arena_t {
+    sort_arena_block_t *top;
+    size_t in_use;              // bytes handed out over all blocks
+    size_t peak;                // most bytes ever in use, an emptied arena keeps or regrows one block of this size
+    size_t keep_limit;          // an emptied arena frees its block if it is larger than this
+    bool huge_pages;            // blocks of 2 MB and more are asked for transparent huge pages
+};
+
+struct sort_arena_mark_t {
+    sort_arena_block_t *block;
+    size_t used;
+    size_t in_use;
+};
+
+void sort_arena_init (sort_arena_t *arena, bool huge_pages);
+void sort_arena_free (sort_arena_t *arena);
+
+/// Calling thread's arena, its block is freed at thread exit or once it outgrows SORT_ARENA_LOCAL_KEEP
+sort_arena_t *sort_arena_local ();
+
+/// Uninitialised, SORT_ARENA_ALIGN aligned, valid until the arena is released to a mark taken before it
+void *sort_arena_alloc (sort_arena_t *arena, size_t size);
+
+sort_arena_mark_t sort_arena_mark (const sort_arena_t *arena);
+void sort_arena_release (sort_arena_t *arena, sort_arena_mark_t mark);
+
+template <typename T>
+T *sort_arena_array (sort_arena_t *arena, size_t count) {
+    return (T *) sort_arena_alloc(arena, count * sizeof(T));
+}
+
 void bubble_sort(int *array, size_t len);
 void selection_sort (int *array, size_t len);
 void insertion_sort_unoptimised (int *array, size_t len);
@@ -14,16 +57,336 @@ void insertion_sort_binsearch (int *array, size_t len);
 void qsort_median (int *array, size_t len);
 void qsort_central (int *array, size_t len);
 void qsort_random (int *array, size_t len);
+void qsort_block (int *array, size_t len);
+void qsort_dual_pivot (int *array, size_t len);
+
+enum pivot_strategy_t {
+    PIVOT_MEDIAN,
+    PIVOT_CENTRAL,
+    PIVOT_RANDOM,
+    PIVOT_XORSHIFT,
+    PIVOT_NINTHER,
+    PIVOT_SQRT_SAMPLE,
+    PIVOT_MEDIAN_OF_MEDIANS,
+};
+
+/// Introsort with the pivot strategy chosen per call
+void qsort_pivot (int *array, size_t len, pivot_strategy_t pivot);
+
+template<pivot_strategy_t pivot>
+void qsort_pivot (int *array, size_t len) {
+    qsort_pivot(array, len, pivot);
+}
+
+/// Returns the value a full sort would put at array[k] and puts it there, smaller values before it, larger after
+int select_kth (int *array, size_t len, size_t k);
+
+/// Sorts the k smallest values into array[0, k), the rest is left in no particular order
+void partial_sort (int *array, size_t len, size_t k);
+
+/// Copies the k smallest values into out in ascending order, array is not modified. O(len log k)
+void top_k (const int *array, size_t len, size_t k, int *out);
+
+void heap_sort (int *array, size_t len);
 
 void merge_sort (int *array, size_t len, int *buf, unsigned int small_buf_size);
 
+/// Leaf size from the host tuning (sort_tuning().merge_small_size)
+void merge_sort (int *array, size_t len);
+void merge_sort (int *array, size_t len, sort_arena_t *arena);
+
+template<unsigned int optimisation_switch_size>
+void merge_sort (int *array, size_t len, sort_arena_t *arena) {
+    sort_arena_mark_t mark = sort_arena_mark(arena);
+    merge_sort(array, len, sort_arena_array<int>(arena, len), optimisation_switch_size);
+    sort_arena_release(arena, mark);
+}
+
 template<unsigned int optimisation_switch_size>
 void merge_sort (int *array, size_t len) {
-    int *buf = (int *) calloc(len, sizeof(int));
-    merge_sort(array, len, buf, optimisation_switch_size);
-    free (buf);
+    merge_sort<optimisation_switch_size>(array, len, sort_arena_local());
+}
+
+enum merge_kernel_t {
+    MERGE_BRANCHY,
+    MERGE_BRANCHLESS,
+    MERGE_SIMD,
+};
+
+void merge_branchless (const int *left, const int *right, size_t left_len, size_t right_len, int *buf);
+
+/// Alternates array and buf between levels instead of copying back, buf must hold len elements
+void merge_sort_pingpong (int *array, size_t len, int *buf, unsigned int small_buf_size, merge_kernel_t kernel);
+
+template<unsigned int optimisation_switch_size, merge_kernel_t kernel>
+void merge_sort_pingpong (int *array, size_t len, sort_arena_t *arena) {
+    sort_arena_mark_t mark = sort_arena_mark(arena);
+    merge_sort_pingpong(array, len, sort_arena_array<int>(arena, len), optimisation_switch_size, kernel);
+    sort_arena_release(arena, mark);
 }
 
+template<unsigned int optimisation_switch_size, merge_kernel_t kernel>
+void merge_sort_pingpong (int *array, size_t len) {
+    merge_sort_pingpong<optimisation_switch_size, kernel>(array, len, sort_arena_local());
+}
+
+/// Sorts run_len-sized runs first, then merges 4 runs per pass. buf must hold len elements
+void merge_sort_bottom_up (int *array, size_t len, int *buf, size_t run_len);
+
+template<size_t run_len>
+void merge_sort_bottom_up (int *array, size_t len, sort_arena_t *arena) {
+    sort_arena_mark_t mark = sort_arena_mark(arena);
+    merge_sort_bottom_up(array, len, sort_arena_array<int>(arena, len), run_len);
+    sort_arena_release(arena, mark);
+}
+
+template<size_t run_len>
+void merge_sort_bottom_up (int *array, size_t len) {
+    merge_sort_bottom_up<run_len>(array, len, sort_arena_local());
+}
+
+/// Stable, scratch is limited to mem_budget bytes (0 means fully in place)
+void merge_sort_inplace (int *array, size_t len, size_t mem_budget);
+void merge_sort_inplace (int *array, size_t len, size_t mem_budget, sort_arena_t *arena);
+
+/// Stable with sqrt(len) scratch
+void merge_sort_inplace (int *array, size_t len);
+
+/// Adaptive natural merge sort, O(len) on presorted input
+void powersort (int *array, size_t len);
+void powersort (int *array, size_t len, sort_arena_t *arena);
+
+// Digit range of the byte-wise radix sorts
+const unsigned int RADIX_BASE = 256;
+
+/// Byte step of value, the sign bit is flipped so negative values come first
+inline unsigned int radix_digit (int value, unsigned int step) {
+    return (((unsigned int) value ^ 0x80000000u) >> (step * 8)) & (RADIX_BASE - 1);
+}
+
+/// LSD radix sort, digit width from radix_sort_digit_bits(len)
 void radix_sort(int *const array_orig, size_t len);
+void radix_sort (int *const array_orig, size_t len, sort_arena_t *arena);
+void radix_sort (int *const array_orig, size_t len, unsigned int digit_bits);
+void radix_sort (int *const array_orig, size_t len, unsigned int digit_bits, sort_arena_t *arena);
+void radix_sort_msd (int *array, size_t len);
+
+/// The host tuning's radix_bits as a ceiling, narrowed for short inputs where clearing the counters would dominate
+unsigned int radix_sort_digit_bits (size_t len);
+void radix_sort (int64_t *array, size_t len);
+void radix_sort (int64_t *array, size_t len, sort_arena_t *arena);
+void radix_sort (float *array, size_t len);
+void radix_sort (float *array, size_t len, sort_arena_t *arena);
+void radix_sort (double *array, size_t len);
+void radix_sort (double *array, size_t len, sort_arena_t *arena);
+
+struct sample_stats_t {
+    int min;
+    int max;
+    size_t distinct;
+    size_t size;
+    size_t ascending;
+    size_t descending;
+    size_t turns;
+};
+
+/// Min, max and distinct count of an evenly spaced sample of at most SORT_NETWORK_MAX_SIZE elements,
+/// plus how many of the sampled elements are strictly below / above their right neighbour, and how often
+/// that direction flips from one unequal sampled pair to the next (few long runs flip rarely, in any direction)
+sample_stats_t sample_stats (const int *array, size_t len);
+
+// Counting sort is used while max - min stays below both len and this, a wider count table stops fitting in cache
+const size_t COUNTING_SORT_MAX_RANGE = 1 << 20;
+
+/// Direct counting if max - min is small next to len, otherwise returns false with array untouched
+bool counting_sort_try (int *array, size_t len);
+
+/// Direct counting if max - min < max_range, otherwise returns false with array untouched
+bool counting_sort_try (int *array, size_t len, size_t max_range);
+bool counting_sort_try (int *array, size_t len, size_t max_range, sort_arena_t *arena);
+
+/// counting_sort_try, radix sort when the value range is too wide
+void counting_sort (int *array, size_t len);
+void counting_sort (int *array, size_t len, sort_arena_t *arena);
+
+// ---------------------------------------------------------------------------------------------------------------------
+// K-way merge
+// ---------------------------------------------------------------------------------------------------------------------
+
+/// Tournament tree over k sorted runs: node i holds the key that lost the match there, keys[0] the overall winner.
+/// Every output element replays one leaf-to-root path, log2(k) comparisons
+struct loser_tree_t {
+    const int **heads;
+    const int **ends;
+    uint64_t *keys;             // (exhausted, value, run) packed so a single compare orders them, ties go to the lower run
+    size_t n_leaves;            // k rounded up to a power of two, the extra leaves start exhausted
+    size_t remaining;
+    sort_arena_t *arena;
+    sort_arena_mark_t mark;
+};
+
+/// Runs must stay valid until loser_tree_free, the tree itself is taken from arena
+void loser_tree_init (loser_tree_t *tree, const int *const *runs, const size_t *run_lens, size_t k, sort_arena_t *arena);
+void loser_tree_free (loser_tree_t *tree);
+
+/// Batched mode: writes the next up to out_len merged elements into out, returns their count (0 once all are out)
+size_t loser_tree_merge (loser_tree_t *tree, int *out, size_t out_len);
+
+/// Merges k sorted runs into out, which must hold the sum of run_lens. Stable: equal values keep the run order
+void merge_k_way (const int *const *runs, const size_t *run_lens, size_t k, int *out);
+void merge_k_way (const int *const *runs, const size_t *run_lens, size_t k, int *out, sort_arena_t *arena);
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Parallel sorts (enkiTS)
+// ---------------------------------------------------------------------------------------------------------------------
+
+void radix_sort_parallel (int *array, size_t len, unsigned int n_threads);
+void radix_sort_parallel (int *array, size_t len, unsigned int n_threads, sort_arena_t *arena);
+
+template<unsigned int n_threads>
+void radix_sort_parallel (int *array, size_t len) {
+    radix_sort_parallel(array, len, n_threads);
+}
+
+/// Stable, buf must hold len elements
+void merge_sort_parallel (int *array, size_t len, int *buf, unsigned int n_threads);
+
+template<unsigned int n_threads>
+void merge_sort_parallel (int *array, size_t len, sort_arena_t *arena) {
+    sort_arena_mark_t mark = sort_arena_mark(arena);
+    merge_sort_parallel(array, len, sort_arena_array<int>(arena, len), n_threads);
+    sort_arena_release(arena, mark);
+}
+
+template<unsigned int n_threads>
+void merge_sort_parallel (int *array, size_t len) {
+    merge_sort_parallel<n_threads>(array, len, sort_arena_local());
+}
+
+void sample_sort (int *array, size_t len, unsigned int n_threads);
+void sample_sort (int *array, size_t len, unsigned int n_threads, sort_arena_t *arena);
+
+template<unsigned int n_threads>
+void sample_sort (int *array, size_t len) {
+    sample_sort(array, len, n_threads);
+}
+
+/// Sorts each segment [offsets[s], offsets[s+1]) of array on its own, offsets holds n_segments + 1 entries
+void segmented_sort (int *array, const size_t *offsets, size_t n_segments, unsigned int n_threads);
+
+template<unsigned int n_threads>
+void segmented_sort (int *array, const size_t *offsets, size_t n_segments) {
+    segmented_sort(array, offsets, n_segments, n_threads);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Key-value sorts
+// ---------------------------------------------------------------------------------------------------------------------
+
+typedef void (*kv_sort_func_t)(int *keys, uint32_t *values, size_t len);
+typedef void (*sort_packed_func_t)(int64_t *items, size_t len);
+
+/// Sorts keys, values move along with their keys. Stable
+void radix_sort_kv (int *keys, uint32_t *values, size_t len);
+void radix_sort_kv (int *keys, uint32_t *values, size_t len, sort_arena_t *arena);
+void merge_sort_kv (int *keys, uint32_t *values, size_t len);
+void merge_sort_kv (int *keys, uint32_t *values, size_t len, sort_arena_t *arena);
+void qsort_kv (int *keys, uint32_t *values, size_t len);
+void qsort_kv (int *keys, uint32_t *values, size_t len, sort_arena_t *arena);
+
+/// Fills indices with the permutation that sorts keys, equal keys keep their order
+void argsort (const int *keys, size_t len, uint32_t *indices);
+void argsort (const int *keys, size_t len, uint32_t *indices, sort_arena_t *arena);
+
+/// Key in the high half, index in the low half: packed items compare like (key, index) pairs
+inline int64_t pack_key_index (int key, uint32_t index) {
+    return (int64_t) ((uint64_t) (int64_t) key << 32 | index);
+}
+
+inline int packed_key (int64_t item) {
+    return (int) (item >> 32);
+}
+
+inline uint32_t packed_index (int64_t item) {
+    return (uint32_t) item;
+}
+
+void radix_sort_packed (int64_t *items, size_t len);
+void radix_sort_packed (int64_t *items, size_t len, sort_arena_t *arena);
+void merge_sort_packed (int64_t *items, size_t len);
+void merge_sort_packed (int64_t *items, size_t len, sort_arena_t *arena);
+void qsort_packed (int64_t *items, size_t len);
+
+// ---------------------------------------------------------------------------------------------------------------------
+// SIMD sorts (AVX-512 / AVX2 / scalar, chosen at runtime)
+// ---------------------------------------------------------------------------------------------------------------------
+
+const size_t SORT_NETWORK_MAX_SIZE = 64;
+
+/// Moves elements < pivot to the front, returns their count
+size_t partition_simd (int *array, size_t len, int pivot);
+
+/// Bitonic sorting network in registers, meant for len <= SORT_NETWORK_MAX_SIZE
+void sort_network (int *array, size_t len);
+
+/// Merges two sorted runs with an AVX2 bitonic merge kernel, 8 elements per step
+void merge_simd (const int *left, const int *right, size_t left_len, size_t right_len, int *buf);
+
+void qsort_simd (int *array, size_t len);
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Automatic dispatch
+// ---------------------------------------------------------------------------------------------------------------------
+
+/// Routing thresholds of sort_auto, generated by lab03 built with CALIBRATE into sort_auto_calibration.h
+struct sort_auto_calibration_t {
+    size_t radix_min_size;          // random input of [radix_min_size, radix_max_size) goes to radix sort,
+    size_t radix_max_size;          // the rest to introsort (qsort_simd)
+    double counting_range_ratio;    // counting sort while max - min < ratio * len
+    double presorted_max_ratio;     // powersort while direction turns are at most this share of the sample
+    double duplicate_max_ratio;     // dual-pivot quicksort while distinct values are at most this share of the sample
+};
+
+extern const sort_auto_calibration_t SORT_AUTO_CALIBRATION;
+
+/// The powersort route of sort_auto: the sampled run structure says few long runs
+bool sort_auto_presorted (const sample_stats_t &stats, const sort_auto_calibration_t &calibration);
+
+/// Samples the input and picks counting, powersort, dual-pivot quicksort, radix or introsort
+void sort_auto (int *array, size_t len);
+void sort_auto (int *array, size_t len, const sort_auto_calibration_t &calibration);
+void sort_auto (int *array, size_t len, const sort_auto_calibration_t &calibration, sort_arena_t *arena);
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Host tuning
+// ---------------------------------------------------------------------------------------------------------------------
+
+/// Parameters whose best value depends on the CPU, measured by lab03 built with TUNE defined
+struct sort_tuning_t {
+    unsigned int merge_small_size;  // merge_sort leaves at most this long go to the network / insertion sort
+    unsigned int radix_bits;        // LSD radix_sort digit width, 1..16
+    size_t qsort_small_size;        // qsort_block and qsort_simd slices at most this long go to the network
+};
+
+const sort_tuning_t SORT_TUNING_DEFAULT = {16, 8, 16};
+
+// Largest leaf sizes the tuner tries, longer leaves would be insertion sorted
+const unsigned int SORT_TUNING_MERGE_SMALL_MAX = 512;
+const size_t SORT_TUNING_QSORT_SMALL_MAX = SORT_NETWORK_MAX_SIZE;
+
+/// Config file of the host tuning: $ALGO_TUNING, or tuning.cfg in the working directory
+const char *sort_tuning_path ();
+
+/// Read once from sort_tuning_path() on first use, SORT_TUNING_DEFAULT for keys missing there
+const sort_tuning_t &sort_tuning ();
+
+/// Replaces the tuning of this process, not thread-safe against running sorts
+void sort_tuning_set (const sort_tuning_t &tuning);
+
+/// Reads "key value" lines over the values already in tuning, returns false if the file cannot be opened
+bool sort_tuning_load (const char *path, sort_tuning_t *tuning);
+
+/// Rewrites the sort keys of the file, lines with other keys (heap_arity of Lab04) are kept
+bool sort_tuning_save (const char *path, const sort_tuning_t &tuning);
 
 #endif //ALGO_SORTS_H
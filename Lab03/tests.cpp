@@ -1,9 +1,13 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <time.h>
+#include <string.h>
+#include <limits.h>
 #include "tests.h"
+#include "generic_sorts.h"
 
 const int TEST_ARRAY_SIZE = 1000;
+const int TEST_LARGE_ARRAY_SIZE = 1 << 20;
 
 // ---------------------------------------------------------------------------------------------------------------------
 
@@ -57,10 +61,89 @@ void test_sorts () {
     _TEST(test_sort_func(qsort_central));
     _TEST(test_sort_func(qsort_median));
     _TEST(test_sort_func(qsort_random));
+    _TEST(test_sort_func_dups(qsort_central));
+    _TEST(test_sort_func_dups(qsort_median));
+    _TEST(test_sort_func_dups(qsort_random));
+    _TEST(test_sort_func(qsort_pivot<PIVOT_XORSHIFT>));
+    _TEST(test_sort_func_large(qsort_pivot<PIVOT_NINTHER>));
+    _TEST(test_sort_func_large(qsort_pivot<PIVOT_SQRT_SAMPLE>));
+    _TEST(test_sort_func_large(qsort_pivot<PIVOT_MEDIAN_OF_MEDIANS>));
+    _TEST(test_sort_func_dups(qsort_pivot<PIVOT_MEDIAN_OF_MEDIANS>));
+    _TEST(test_sort_func(qsort_dual_pivot));
+    _TEST(test_selection());
+    _TEST(test_sort_func_large(qsort_dual_pivot));
+    _TEST(test_sort_func_dups(qsort_dual_pivot));
+    _TEST(test_sort_func(qsort_block));
+    _TEST(test_sort_func_large(qsort_block));
+    _TEST(test_sort_func_dups(qsort_block));
+    _TEST(test_sort_func(qsort_simd));
+    _TEST(test_sort_func_large(qsort_simd));
+    _TEST(test_sort_func_dups(qsort_simd));
 
+    _TEST(test_sort_func(heap_sort));
+
+    _TEST(test_generic_sort());
+
+    _TEST(test_sort_network());
+
+    _TEST(test_sort_func(merge_sort<16>));
     _TEST(test_sort_func(merge_sort));
+    _TEST(test_sort_func(merge_sort_parallel<4>));
+    _TEST(test_sort_func_large(merge_sort_parallel<4>));
+    _TEST(test_sort_func(merge_sort_pingpong<16, MERGE_BRANCHY>));
+    _TEST(test_sort_func(merge_sort_pingpong<16, MERGE_BRANCHLESS>));
+    _TEST(test_sort_func(merge_sort_pingpong<16, MERGE_SIMD>));
+    _TEST(test_sort_func_dups(merge_sort_pingpong<16, MERGE_SIMD>));
+    _TEST(test_sort_func(merge_sort_bottom_up<100>));
+    _TEST(test_sort_func_large(merge_sort_bottom_up<1000>));
+    _TEST(test_sort_func(powersort));
+    _TEST(test_sort_func_large(powersort));
+    _TEST(test_sort_func_dups(powersort));
+    _TEST(test_sort_func(merge_sort_inplace));
+    _TEST(test_sort_func_large(merge_sort_inplace));
+    _TEST(test_sort_func_dups(merge_sort_inplace));
+    _TEST(test_sort_func([] (int *array, size_t len) { merge_sort_inplace(array, len, 0); }));
+    _TEST(test_sort_func(sample_sort<4>));
+    _TEST(test_sort_func_large(sample_sort<4>));
+    _TEST(test_sort_func_dups(sample_sort<4>));
 
     _TEST(test_sort_func(radix_sort));
+    _TEST(test_sort_func_signed(radix_sort));
+    _TEST(test_radix_sort_bits());
+    _TEST(test_radix_sort_keys());
+    _TEST(test_sort_func(radix_sort_msd));
+    _TEST(test_sort_func_large(radix_sort_msd));
+    _TEST(test_sort_func_dups(radix_sort_msd));
+    _TEST(test_sort_func_signed(radix_sort_msd));
+
+    _TEST(test_sort_func(counting_sort));
+    _TEST(test_sort_func_dups(counting_sort));
+    _TEST(test_sort_func_signed(counting_sort));
+    _TEST(test_counting_sort_try());
+
+    _TEST(test_sort_func(radix_sort_parallel<4>));
+    _TEST(test_sort_func_large(radix_sort_parallel<4>));
+    _TEST(test_sort_func_signed(radix_sort_parallel<4>));
+
+    _TEST(test_segmented_sort(1));
+    _TEST(test_segmented_sort(4));
+
+    _TEST(test_kv_sort_func(radix_sort_kv));
+    _TEST(test_kv_sort_func(merge_sort_kv));
+    _TEST(test_kv_sort_func(qsort_kv));
+    _TEST(test_packed_sort_func(radix_sort_packed));
+    _TEST(test_packed_sort_func(merge_sort_packed));
+    _TEST(test_packed_sort_func(qsort_packed));
+    _TEST(test_argsort());
+
+    _TEST(test_sort_func(sort_auto));
+    _TEST(test_sort_func_large(sort_auto));
+    _TEST(test_sort_func_dups(sort_auto));
+    _TEST(test_sort_func_signed(sort_auto));
+    _TEST(test_sort_auto());
+    _TEST(test_sort_tuning());
+    _TEST(test_sort_arena());
+    _TEST(test_merge_k_way());
 
     printf ("Tests total: %u, failed %u, success: %u, success ratio: %3.1lf%%\n",
             failed + success, failed, success, success * 100.0 / (success + failed));
@@ -83,3 +166,586 @@ int test_sort_func (sort_func_t func) {
 
     return 0;
 }
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+/// Big enough to hit multi-threaded paths, so duplicates are expected
+int test_sort_func_large (sort_func_t func) {
+    static int array[TEST_LARGE_ARRAY_SIZE];
+
+    for (int i = 0; i < TEST_LARGE_ARRAY_SIZE; ++i) {
+        array[i] = rand();
+    }
+
+    func(array, TEST_LARGE_ARRAY_SIZE);
+
+    for (int i = 0; i < TEST_LARGE_ARRAY_SIZE-1; ++i) {
+        _ASSERT(array[i] <= array[i+1]);
+    }
+
+    return 0;
+}
+
+/// Only 8 distinct values, like gen_zebra_array
+int test_sort_func_dups (sort_func_t func) {
+    static int array[TEST_LARGE_ARRAY_SIZE];
+
+    for (int i = 0; i < TEST_LARGE_ARRAY_SIZE; ++i) {
+        array[i] = rand() % 8;
+    }
+
+    func(array, TEST_LARGE_ARRAY_SIZE);
+
+    for (int i = 0; i < TEST_LARGE_ARRAY_SIZE-1; ++i) {
+        _ASSERT(array[i] <= array[i+1]);
+    }
+
+    return 0;
+}
+
+/// Negative and positive values, the top byte decides the order
+int test_sort_func_signed (sort_func_t func) {
+    static int array[TEST_LARGE_ARRAY_SIZE];
+
+    for (int i = 0; i < TEST_LARGE_ARRAY_SIZE; ++i) {
+        array[i] = rand() - RAND_MAX / 2;
+    }
+
+    func(array, TEST_LARGE_ARRAY_SIZE);
+
+    for (int i = 0; i < TEST_LARGE_ARRAY_SIZE-1; ++i) {
+        _ASSERT(array[i] <= array[i+1]);
+    }
+
+    return 0;
+}
+
+/// 64-bit and floating point overloads, with signed zeros and infinities mixed in
+int test_radix_sort_keys () {
+    static int64_t longs[TEST_ARRAY_SIZE];
+    static float floats[TEST_ARRAY_SIZE];
+    static double doubles[TEST_ARRAY_SIZE];
+
+    for (int i = 0; i < TEST_ARRAY_SIZE; ++i) {
+        longs[i] = ((int64_t) rand() << 32 | rand()) - ((int64_t) RAND_MAX << 31);
+        floats[i] = (float) (rand() - RAND_MAX / 2) / 1000;
+        doubles[i] = (double) (rand() - RAND_MAX / 2) / 1e6;
+    }
+
+    floats[0] = -0.0f;
+    floats[1] = 0.0f;
+    doubles[0] = 1.0 / 0.0;
+    doubles[1] = -1.0 / 0.0;
+    doubles[2] = -0.0;
+
+    radix_sort(longs, TEST_ARRAY_SIZE);
+    radix_sort(floats, TEST_ARRAY_SIZE);
+    radix_sort(doubles, TEST_ARRAY_SIZE);
+
+    for (int i = 0; i < TEST_ARRAY_SIZE-1; ++i) {
+        _ASSERT(longs[i] <= longs[i+1]);
+        _ASSERT(floats[i] <= floats[i+1]);
+        _ASSERT(doubles[i] <= doubles[i+1]);
+    }
+
+    return 0;
+}
+
+/// Values start as positions, so they must point back at the key and grow within equal keys
+int test_kv_sort_func (kv_sort_func_t func) {
+    static int keys_orig[TEST_LARGE_ARRAY_SIZE];
+    static int keys[TEST_LARGE_ARRAY_SIZE];
+    static uint32_t values[TEST_LARGE_ARRAY_SIZE];
+
+    for (int i = 0; i < TEST_LARGE_ARRAY_SIZE; ++i) {
+        keys_orig[i] = keys[i] = rand() % 1000 - 500;
+        values[i] = (uint32_t) i;
+    }
+
+    func(keys, values, TEST_LARGE_ARRAY_SIZE);
+
+    for (int i = 0; i < TEST_LARGE_ARRAY_SIZE; ++i) {
+        _ASSERT(keys_orig[values[i]] == keys[i]);
+    }
+
+    for (int i = 0; i < TEST_LARGE_ARRAY_SIZE-1; ++i) {
+        _ASSERT(keys[i] < keys[i+1] || (keys[i] == keys[i+1] && values[i] < values[i+1]));
+    }
+
+    return 0;
+}
+
+int test_packed_sort_func (sort_packed_func_t func) {
+    static int64_t items[TEST_LARGE_ARRAY_SIZE];
+
+    for (int i = 0; i < TEST_LARGE_ARRAY_SIZE; ++i) {
+        items[i] = pack_key_index(rand() - RAND_MAX / 2, (uint32_t) rand());
+    }
+
+    func(items, TEST_LARGE_ARRAY_SIZE);
+
+    for (int i = 0; i < TEST_LARGE_ARRAY_SIZE-1; ++i) {
+        int key = packed_key(items[i]);
+        int next_key = packed_key(items[i+1]);
+
+        _ASSERT(key < next_key || (key == next_key && packed_index(items[i]) <= packed_index(items[i+1])));
+    }
+
+    return 0;
+}
+
+int test_argsort () {
+    int keys[TEST_ARRAY_SIZE];
+    uint32_t indices[TEST_ARRAY_SIZE];
+
+    for (int i = 0; i < TEST_ARRAY_SIZE; ++i) {
+        keys[i] = rand() % 100 - 50;
+    }
+
+    argsort(keys, TEST_ARRAY_SIZE, indices);
+
+    for (int i = 0; i < TEST_ARRAY_SIZE-1; ++i) {
+        _ASSERT(keys[indices[i]] < keys[indices[i+1]] ||
+                (keys[indices[i]] == keys[indices[i+1]] && indices[i] < indices[i+1]));
+    }
+
+    return 0;
+}
+
+struct test_record_t {
+    int64_t key;
+    int payload;
+};
+
+/// 64-bit keys with every algorithm, then struct keys in descending order through a comparator
+template <typename Algorithm, typename PivotPolicy>
+static int test_generic_sort_algo (bool stable) {
+    static int64_t longs[TEST_LARGE_ARRAY_SIZE];
+    static test_record_t records[TEST_ARRAY_SIZE];
+
+    size_t len = stable ? TEST_LARGE_ARRAY_SIZE : TEST_ARRAY_SIZE;
+
+    for (size_t i = 0; i < len; ++i) {
+        longs[i] = ((int64_t) rand() << 32 | rand()) - ((int64_t) RAND_MAX << 31);
+    }
+
+    for (int i = 0; i < TEST_ARRAY_SIZE; ++i) {
+        records[i] = {rand() % 50, i};
+    }
+
+    sort<Algorithm, PivotPolicy>(longs, len);
+    sort<Algorithm, PivotPolicy>(records, TEST_ARRAY_SIZE, [] (const test_record_t &lhs, const test_record_t &rhs) {
+        return lhs.key > rhs.key;
+    });
+
+    for (size_t i = 0; i < len-1; ++i) {
+        _ASSERT(longs[i] <= longs[i+1]);
+    }
+
+    for (int i = 0; i < TEST_ARRAY_SIZE-1; ++i) {
+        _ASSERT(records[i].key >= records[i+1].key);
+        _ASSERT(!stable || records[i].key > records[i+1].key || records[i].payload < records[i+1].payload);
+    }
+
+    return 0;
+}
+
+int test_generic_sort () {
+    _ASSERT((test_generic_sort_algo<quick_sort_t, pivot_median_t>(false) == 0));
+    _ASSERT((test_generic_sort_algo<quick_sort_t, pivot_central_t>(false) == 0));
+    _ASSERT((test_generic_sort_algo<quick_sort_t, pivot_random_t>(false) == 0));
+    _ASSERT((test_generic_sort_algo<dual_pivot_quick_sort_t, pivot_median_t>(false) == 0));
+    _ASSERT((test_generic_sort_algo<quick_sort_t, pivot_ninther_t>(false) == 0));
+    _ASSERT((test_generic_sort_algo<quick_sort_t, pivot_sqrt_sample_t>(false) == 0));
+    _ASSERT((test_generic_sort_algo<quick_sort_t, pivot_median_of_medians_t>(false) == 0));
+    _ASSERT((test_generic_sort_algo<heap_sort_t, pivot_median_t>(false) == 0));
+    _ASSERT((test_generic_sort_algo<insertion_sort_t, pivot_median_t>(false) == 0));
+    _ASSERT((test_generic_sort_algo<merge_sort_t, pivot_median_t>(true) == 0));
+
+    return 0;
+}
+
+/// Mixed segment lengths, empty ones included, cover every kernel; values must not cross segment borders
+int test_segmented_sort (unsigned int n_threads) {
+    static int array[TEST_LARGE_ARRAY_SIZE];
+    static size_t offsets[TEST_LARGE_ARRAY_SIZE + 1];
+
+    size_t n_segments = 0;
+    size_t pos = 0;
+
+    while (true) {
+        size_t seg_len = (rand() % 100 == 0) ? rand() % 20000 : rand() % 100;
+
+        if (pos + seg_len > TEST_LARGE_ARRAY_SIZE) {
+            break;
+        }
+
+        offsets[n_segments++] = pos;
+        pos += seg_len;
+    }
+
+    offsets[n_segments] = pos;
+
+    for (size_t seg = 0; seg < n_segments; ++seg) {
+        for (size_t i = offsets[seg]; i < offsets[seg+1]; ++i) {
+            array[i] = (int) (seg * 1000) - rand() % 1000;
+        }
+    }
+
+    segmented_sort(array, offsets, n_segments, n_threads);
+
+    for (size_t seg = 0; seg < n_segments; ++seg) {
+        for (size_t i = offsets[seg]; i < offsets[seg+1]; ++i) {
+            _ASSERT(array[i] > (int) (seg * 1000) - 1000 && array[i] <= (int) (seg * 1000));
+            _ASSERT(i == offsets[seg] || array[i-1] <= array[i]);
+        }
+    }
+
+    return 0;
+}
+
+/// Narrow ranges are sorted in place, wide ones are refused without touching the array
+int test_counting_sort_try () {
+    static int array[TEST_LARGE_ARRAY_SIZE];
+
+    for (int i = 0; i < TEST_LARGE_ARRAY_SIZE; ++i) {
+        array[i] = -1000 + rand() % 2000;
+    }
+
+    _ASSERT(counting_sort_try(array, TEST_LARGE_ARRAY_SIZE));
+
+    for (int i = 0; i < TEST_LARGE_ARRAY_SIZE-1; ++i) {
+        _ASSERT(array[i] <= array[i+1]);
+    }
+
+    // Only one outlier, the sample cannot see it but the full scan does
+    array[TEST_LARGE_ARRAY_SIZE / 2 + 1] = RAND_MAX;
+    array[TEST_LARGE_ARRAY_SIZE / 2 + 2] = -RAND_MAX;
+
+    _ASSERT(!counting_sort_try(array, TEST_LARGE_ARRAY_SIZE));
+    _ASSERT(array[TEST_LARGE_ARRAY_SIZE / 2 + 1] == RAND_MAX);
+
+    sample_stats_t stats = sample_stats(array, TEST_LARGE_ARRAY_SIZE);
+    _ASSERT(stats.size == SORT_NETWORK_MAX_SIZE && stats.distinct <= stats.size);
+    _ASSERT(stats.min >= -1000 && stats.max < 1000);
+
+    return 0;
+}
+
+/// Every route of sort_auto forced by its calibration, on input shaped for that route and on random input
+int test_sort_auto () {
+    static int array[TEST_LARGE_ARRAY_SIZE];
+    const sort_auto_calibration_t routes[] = {
+            {SIZE_MAX, SIZE_MAX, 0, -1, -1},    // introsort
+            {0, SIZE_MAX, 0, -1, -1},           // radix
+            {SIZE_MAX, SIZE_MAX, 4, -1, -1},    // counting
+            {SIZE_MAX, SIZE_MAX, 0, 1, -1},     // powersort
+            {SIZE_MAX, SIZE_MAX, 0, -1, 1},     // dual pivot
+    };
+
+    for (int i = 0; i < TEST_LARGE_ARRAY_SIZE; ++i) {
+        array[i] = i;
+    }
+
+    sample_stats_t stats = sample_stats(array, TEST_LARGE_ARRAY_SIZE);
+    _ASSERT(stats.ascending == stats.size && stats.descending == 0 && stats.turns == 0);
+
+    // Organ pipe, then sawtooth of 2 to 4 teeth, values spread wider than len so counting cannot take them
+    for (int n_teeth = 1; n_teeth <= 4; ++n_teeth) {
+        int tooth_len = TEST_LARGE_ARRAY_SIZE / n_teeth;
+
+        for (int i = 0; i < TEST_LARGE_ARRAY_SIZE; ++i) {
+            int mirrored = TEST_LARGE_ARRAY_SIZE - i;
+            array[i] = (n_teeth == 1) ? 3 * ((i < mirrored) ? i : mirrored) : 3 * (i % tooth_len);
+        }
+
+        _ASSERT(sort_auto_presorted(sample_stats(array, TEST_LARGE_ARRAY_SIZE), SORT_AUTO_CALIBRATION));
+        sort_auto(array, TEST_LARGE_ARRAY_SIZE);
+
+        for (int i = 0; i < TEST_LARGE_ARRAY_SIZE-1; ++i) {
+            _ASSERT(array[i] <= array[i+1]);
+        }
+    }
+
+    for (int i = 0; i < TEST_LARGE_ARRAY_SIZE; ++i) {
+        array[i] = rand() - RAND_MAX / 2;
+    }
+
+    _ASSERT(!sort_auto_presorted(sample_stats(array, TEST_LARGE_ARRAY_SIZE), SORT_AUTO_CALIBRATION));
+
+    for (const sort_auto_calibration_t &route : routes) {
+        for (int shape = 0; shape < 3; ++shape) {
+            for (int i = 0; i < TEST_LARGE_ARRAY_SIZE; ++i) {
+                array[i] = (shape == 0) ? rand() - RAND_MAX / 2 :
+                           (shape == 1) ? TEST_LARGE_ARRAY_SIZE - i :
+                           rand() % 4 - 2;
+            }
+
+            sort_auto(array, TEST_LARGE_ARRAY_SIZE, route);
+
+            for (int i = 0; i < TEST_LARGE_ARRAY_SIZE-1; ++i) {
+                _ASSERT(array[i] <= array[i+1]);
+            }
+        }
+    }
+
+    return 0;
+}
+
+/// Every digit width, including ones that leave a partial top digit
+int test_radix_sort_bits () {
+    static int array[TEST_ARRAY_SIZE];
+
+    for (unsigned int bits = 1; bits <= 16; ++bits) {
+        for (int i = 0; i < TEST_ARRAY_SIZE; ++i) {
+            array[i] = rand() - RAND_MAX / 2;
+        }
+
+        radix_sort(array, TEST_ARRAY_SIZE, bits);
+
+        for (int i = 0; i < TEST_ARRAY_SIZE-1; ++i) {
+            _ASSERT(array[i] <= array[i+1]);
+        }
+    }
+
+    return 0;
+}
+
+/// Load skips bad values, save keeps foreign keys, and the tuned sorts still sort with the loaded values
+int test_sort_tuning () {
+    const char *path = "tuning_test.cfg";
+    FILE *file = fopen(path, "w");
+    _ASSERT(file != NULL);
+    fprintf(file, "# host\nheap_arity 4\nradix_bits 40\nqsort_small_size 40\nmerge_small_size 0\n");
+    fclose(file);
+
+    sort_tuning_t tuning = SORT_TUNING_DEFAULT;
+    _ASSERT(sort_tuning_load(path, &tuning));
+    _ASSERT(tuning.radix_bits == SORT_TUNING_DEFAULT.radix_bits);
+    _ASSERT(tuning.qsort_small_size == 40 && tuning.merge_small_size == 0);
+
+    tuning.radix_bits = 11;
+    _ASSERT(sort_tuning_save(path, tuning));
+
+    sort_tuning_t reloaded = SORT_TUNING_DEFAULT;
+    _ASSERT(sort_tuning_load(path, &reloaded));
+    _ASSERT(reloaded.radix_bits == 11 && reloaded.qsort_small_size == 40 && reloaded.merge_small_size == 0);
+
+    FILE *oversized = fopen("tuning_oversized.cfg", "w");
+    _ASSERT(oversized != NULL);
+    fprintf(oversized, "merge_small_size 100000000\nqsort_small_size 100000000\n");
+    fclose(oversized);
+
+    sort_tuning_t rejected = SORT_TUNING_DEFAULT;
+    _ASSERT(sort_tuning_load("tuning_oversized.cfg", &rejected));
+    remove("tuning_oversized.cfg");
+    _ASSERT(rejected.merge_small_size == SORT_TUNING_DEFAULT.merge_small_size &&
+            rejected.qsort_small_size == SORT_TUNING_DEFAULT.qsort_small_size);
+
+    char line[64] = {};
+    file = fopen(path, "r");
+    _ASSERT(fgets(line, sizeof(line), file) != NULL && fgets(line, sizeof(line), file) != NULL);
+    fclose(file);
+    remove(path);
+    _ASSERT(strcmp(line, "heap_arity 4\n") == 0);
+
+    sort_tuning_t saved = sort_tuning();
+    sort_tuning_set(reloaded);
+    int failed = test_sort_func(radix_sort) || test_sort_func(qsort_simd) || test_sort_func(qsort_block) ||
+                 test_sort_func(merge_sort);
+
+    // The tuned radix width is a ceiling, short inputs keep narrow digits
+    sort_tuning_t wide = reloaded;
+    wide.radix_bits = 16;
+    sort_tuning_set(wide);
+    bool narrowed = radix_sort_digit_bits(300) == 8 && radix_sort_digit_bits(1 << 22) == 16;
+    failed = failed || test_sort_func(radix_sort);
+
+    wide.radix_bits = 4;
+    sort_tuning_set(wide);
+    narrowed = narrowed && radix_sort_digit_bits(300) == 4 && radix_sort_digit_bits(1 << 22) == 4;
+
+    sort_tuning_set(saved);
+    _ASSERT(!failed && narrowed);
+
+    return 0;
+}
+
+static sort_arena_t test_arena;
+
+/// Bump allocation across stacked blocks, block reuse after release, and every arena-taking sort on a shared arena
+int test_sort_arena () {
+    const size_t big_size = 8 << 20;
+    sort_arena_init(&test_arena, true);
+
+    sort_arena_mark_t mark = sort_arena_mark(&test_arena);
+    int *first = sort_arena_array<int>(&test_arena, TEST_ARRAY_SIZE);
+    first[TEST_ARRAY_SIZE - 1] = 42;
+
+    sort_arena_mark_t inner = sort_arena_mark(&test_arena);
+    char *big = (char *) sort_arena_alloc(&test_arena, big_size);
+    memset(big, 1, big_size);
+    _ASSERT(first[TEST_ARRAY_SIZE - 1] == 42);
+    _ASSERT((size_t) first % SORT_ARENA_ALIGN == 0 && (size_t) big % SORT_ARENA_ALIGN == 0);
+
+    sort_arena_release(&test_arena, inner);
+    _ASSERT(first[TEST_ARRAY_SIZE - 1] == 42);
+    sort_arena_release(&test_arena, mark);
+    _ASSERT(test_arena.in_use == 0 && test_arena.peak >= big_size);
+
+    // Emptied arena holds one block of the peak size, the next sort of that size gets it without allocating
+    void *reused = sort_arena_alloc(&test_arena, test_arena.peak);
+    sort_arena_release(&test_arena, mark);
+    _ASSERT(sort_arena_alloc(&test_arena, test_arena.peak) == reused);
+    sort_arena_release(&test_arena, mark);
+
+    _ASSERT(!test_sort_func([] (int *array, size_t len) { radix_sort(array, len, &test_arena); }));
+    _ASSERT(!test_sort_func([] (int *array, size_t len) { radix_sort(array, len, 11u, &test_arena); }));
+    _ASSERT(!test_sort_func([] (int *array, size_t len) { merge_sort(array, len, &test_arena); }));
+    _ASSERT(!test_sort_func([] (int *array, size_t len) { merge_sort<16>(array, len, &test_arena); }));
+    _ASSERT(!test_sort_func([] (int *array, size_t len) {
+        merge_sort_pingpong<16, MERGE_BRANCHLESS>(array, len, &test_arena);
+    }));
+    _ASSERT(!test_sort_func([] (int *array, size_t len) { merge_sort_bottom_up<64>(array, len, &test_arena); }));
+    _ASSERT(!test_sort_func([] (int *array, size_t len) { merge_sort_inplace(array, len, 256, &test_arena); }));
+    _ASSERT(!test_sort_func([] (int *array, size_t len) { powersort(array, len, &test_arena); }));
+    _ASSERT(!test_sort_func_dups([] (int *array, size_t len) { counting_sort(array, len, &test_arena); }));
+    _ASSERT(!test_sort_func_large([] (int *array, size_t len) { sample_sort(array, len, 4, &test_arena); }));
+    _ASSERT(!test_sort_func_large([] (int *array, size_t len) { radix_sort_parallel(array, len, 4, &test_arena); }));
+    _ASSERT(!test_sort_func_large([] (int *array, size_t len) { merge_sort_parallel<4>(array, len, &test_arena); }));
+    _ASSERT(!test_sort_func_large([] (int *array, size_t len) {
+        sort_auto(array, len, SORT_AUTO_CALIBRATION, &test_arena);
+    }));
+    _ASSERT(!test_kv_sort_func([] (int *keys, uint32_t *values, size_t len) {
+        radix_sort_kv(keys, values, len, &test_arena);
+    }));
+    _ASSERT(!test_kv_sort_func([] (int *keys, uint32_t *values, size_t len) {
+        merge_sort_kv(keys, values, len, &test_arena);
+    }));
+    _ASSERT(!test_kv_sort_func([] (int *keys, uint32_t *values, size_t len) {
+        qsort_kv(keys, values, len, &test_arena);
+    }));
+
+    _ASSERT(test_arena.in_use == 0);
+    sort_arena_free(&test_arena);
+
+    return 0;
+}
+
+/// Output equals the sorted concatenation of the runs, in one call and in odd-sized batches
+int test_merge_k_way () {
+    const size_t max_k = 300;
+    static int data[TEST_LARGE_ARRAY_SIZE];
+    static int expected[TEST_LARGE_ARRAY_SIZE];
+    static int out[TEST_LARGE_ARRAY_SIZE];
+    static const int *runs[max_k];
+    static size_t run_lens[max_k];
+    const size_t ks[] = {0, 1, 2, 3, 7, 64, max_k};
+
+    for (size_t k : ks) {
+        size_t total = 0;
+
+        for (size_t run = 0; run < k; ++run) {
+            run_lens[run] = (run % 5 == 4) ? 0 : rand() % 200;
+            runs[run] = data + total;
+
+            for (size_t i = 0; i < run_lens[run]; ++i) {
+                int kind = rand() % 100;
+                data[total + i] = (kind == 0) ? INT_MIN : (kind == 1) ? INT_MAX : rand() % 1000 - 500;
+            }
+
+            qsort_block(data + total, run_lens[run]);
+            total += run_lens[run];
+        }
+
+        memcpy(expected, data, total * sizeof(int));
+        qsort_block(expected, total);
+
+        merge_k_way(runs, run_lens, k, out);
+        _ASSERT(memcmp(out, expected, total * sizeof(int)) == 0);
+
+        loser_tree_t tree;
+        size_t merged = 0;
+        size_t batch;
+
+        memset(out, 0, total * sizeof(int));
+        loser_tree_init(&tree, runs, run_lens, k, sort_arena_local());
+
+        while ((batch = loser_tree_merge(&tree, out + merged, 7)) > 0) {
+            merged += batch;
+        }
+
+        loser_tree_free(&tree);
+        _ASSERT(merged == total && memcmp(out, expected, total * sizeof(int)) == 0);
+    }
+
+    return 0;
+}
+
+struct pivot_first_t {
+    template <typename T, typename Compare>
+    static size_t choose (const T *, size_t, Compare &) {
+        return 0;
+    }
+};
+
+/// select_kth, partial_sort and top_k against a fully sorted copy, with and without duplicates
+int test_selection () {
+    static int orig[TEST_LARGE_ARRAY_SIZE];
+    static int sorted[TEST_LARGE_ARRAY_SIZE];
+    static int array[TEST_LARGE_ARRAY_SIZE];
+    static int out[TEST_ARRAY_SIZE];
+
+    for (int dups = 0; dups < 2; ++dups) {
+        for (int i = 0; i < TEST_LARGE_ARRAY_SIZE; ++i) {
+            orig[i] = sorted[i] = dups ? rand() % 8 : rand() - RAND_MAX / 2;
+        }
+
+        qsort_block(sorted, TEST_LARGE_ARRAY_SIZE);
+
+        size_t ks[] = {0, 1, TEST_ARRAY_SIZE, TEST_LARGE_ARRAY_SIZE / 2, TEST_LARGE_ARRAY_SIZE * 99 / 100,
+                       TEST_LARGE_ARRAY_SIZE - 1};
+
+        for (size_t k : ks) {
+            memcpy(array, orig, sizeof(orig));
+            _ASSERT(select_kth(array, TEST_LARGE_ARRAY_SIZE, k) == sorted[k]);
+
+            for (size_t i = 0; i < TEST_LARGE_ARRAY_SIZE; ++i) {
+                _ASSERT(i <= k ? array[i] <= array[k] : array[i] >= array[k]);
+            }
+        }
+
+        memcpy(array, orig, sizeof(orig));
+        partial_sort(array, TEST_LARGE_ARRAY_SIZE, TEST_ARRAY_SIZE);
+        _ASSERT(memcmp(array, sorted, TEST_ARRAY_SIZE * sizeof(int)) == 0);
+
+        top_k(orig, TEST_LARGE_ARRAY_SIZE, TEST_ARRAY_SIZE, out);
+        _ASSERT(memcmp(out, sorted, TEST_ARRAY_SIZE * sizeof(int)) == 0);
+
+        // The first element of sorted input is the worst pivot, this runs out of depth into median of medians
+        memcpy(array, sorted, sizeof(sorted));
+        sort_select_kth<pivot_first_t>(array, TEST_LARGE_ARRAY_SIZE, TEST_LARGE_ARRAY_SIZE / 3);
+        _ASSERT(array[TEST_LARGE_ARRAY_SIZE / 3] == sorted[TEST_LARGE_ARRAY_SIZE / 3]);
+    }
+
+    return 0;
+}
+
+/// Every length the network accepts
+int test_sort_network () {
+    int array[SORT_NETWORK_MAX_SIZE];
+
+    for (size_t len = 0; len <= SORT_NETWORK_MAX_SIZE; ++len) {
+        for (size_t i = 0; i < len; ++i) {
+            array[i] = rand() % 32 - 16;
+        }
+
+        sort_network(array, len);
+
+        for (size_t i = 1; i < len; ++i) {
+            _ASSERT(array[i-1] <= array[i]);
+        }
+    }
+
+    return 0;
+}
@@ -5,5 +5,22 @@
 
 void test_sorts ();
 int test_sort_func (sort_func_t func);
+int test_sort_func_large (sort_func_t func);
+int test_sort_func_dups (sort_func_t func);
+int test_sort_func_signed (sort_func_t func);
+int test_radix_sort_keys ();
+int test_kv_sort_func (kv_sort_func_t func);
+int test_packed_sort_func (sort_packed_func_t func);
+int test_argsort ();
+int test_generic_sort ();
+int test_segmented_sort (unsigned int n_threads);
+int test_counting_sort_try ();
+int test_selection ();
+int test_sort_auto ();
+int test_radix_sort_bits ();
+int test_sort_tuning ();
+int test_sort_arena ();
+int test_merge_k_way ();
+int test_sort_network ();
 
 #endif //ALGO_TESTS_H
@@ -0,0 +1,121 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sorts.h"
+
+const char *const SORT_TUNING_DEFAULT_PATH = "tuning.cfg";
+const size_t TUNING_LINE_SIZE = 256;
+
+static sort_tuning_t &current_tuning ();
+static bool is_sort_key (const char *line);
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Host tuning
+// ---------------------------------------------------------------------------------------------------------------------
+
+const char *sort_tuning_path () {
+    const char *path = getenv("ALGO_TUNING");
+    return (path != NULL && path[0] != '\0') ? path : SORT_TUNING_DEFAULT_PATH;
+}
+
+const sort_tuning_t &sort_tuning () {
+    return current_tuning();
+}
+
+void sort_tuning_set (const sort_tuning_t &tuning) {
+    current_tuning() = tuning;
+}
+
+/// Unknown keys and out of range values are skipped, so a stale or foreign file cannot break the sorts
+bool sort_tuning_load (const char *path, sort_tuning_t *tuning) {
+    FILE *file = fopen(path, "r");
+
+    if (file == NULL) {
+        return false;
+    }
+
+    char line[TUNING_LINE_SIZE];
+
+    while (fgets(line, sizeof(line), file) != NULL) {
+        char key[64];
+        unsigned long value;
+
+        if (sscanf(line, "%63s %lu", key, &value) != 2) {
+            continue;
+        }
+
+        if (strcmp(key, "merge_small_size") == 0 && value <= SORT_TUNING_MERGE_SMALL_MAX) {
+            tuning->merge_small_size = (unsigned int) value;
+        } else if (strcmp(key, "radix_bits") == 0 && value >= 1 && value <= 16) {
+            tuning->radix_bits = (unsigned int) value;
+        } else if (strcmp(key, "qsort_small_size") == 0 && value >= 1 && value <= SORT_TUNING_QSORT_SMALL_MAX) {
+            tuning->qsort_small_size = value;
+        }
+    }
+
+    fclose(file);
+    return true;
+}
+
+bool sort_tuning_save (const char *path, const sort_tuning_t &tuning) {
+    char *kept = NULL;
+    size_t kept_len = 0;
+    FILE *file = fopen(path, "r");
+
+    if (file != NULL) {
+        char line[TUNING_LINE_SIZE];
+
+        while (fgets(line, sizeof(line), file) != NULL) {
+            if (is_sort_key(line)) {
+                continue;
+            }
+
+            size_t line_len = strlen(line);
+            kept = (char *) realloc(kept, kept_len + line_len);
+            memcpy(kept + kept_len, line, line_len);
+            kept_len += line_len;
+        }
+
+        fclose(file);
+    }
+
+    file = fopen(path, "w");
+
+    if (file == NULL) {
+        free(kept);
+        return false;
+    }
+
+    fwrite(kept, 1, kept_len, file);
+    fprintf(file, "merge_small_size %u\n", tuning.merge_small_size);
+    fprintf(file, "radix_bits %u\n", tuning.radix_bits);
+    fprintf(file, "qsort_small_size %zu\n", tuning.qsort_small_size);
+
+    free(kept);
+    return fclose(file) == 0;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+// lib functions
+// ---------------------------------------------------------------------------------------------------------------------
+
+static sort_tuning_t &current_tuning () {
+    static sort_tuning_t tuning = [] {
+        sort_tuning_t loaded = SORT_TUNING_DEFAULT;
+        sort_tuning_load(sort_tuning_path(), &loaded);
+        return loaded;
+    }();
+
+    return tuning;
+}
+
+static bool is_sort_key (const char *line) {
+    char key[64];
+
+    if (sscanf(line, "%63s", key) != 1) {
+        return false;
+    }
+
+    return strcmp(key, "merge_small_size") == 0 || strcmp(key, "radix_bits") == 0 ||
+           strcmp(key, "qsort_small_size") == 0;
+}
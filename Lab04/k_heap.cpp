@@ -1,5 +1,6 @@
 #include "k_heap.h"
 
+#include <stdio.h>
 #include <string.h>
 
 #define NDEBUG
@@ -29,6 +30,10 @@ const unsigned int START_CAPACITY = 1024;
 
 typedef unsigned int uint;
 
+const uint DEFAULT_HEAP_DEPTH = 2;
+const char *const DEFAULT_TUNING_PATH = "tuning.cfg";
+const size_t TUNING_LINE_SIZE = 256;
+
 // ---------------------------------------------------------------------------------------------------------------------
 // Prototypes
 // ---------------------------------------------------------------------------------------------------------------------
@@ -39,6 +44,10 @@ static void heap_sift_down(struct k_heap_t *self, size_t indx);
 
 static void heap_swap(struct k_heap_t *self, size_t left, size_t right);
 
+static size_t heap_parent(struct k_heap_t *self, size_t indx);
+
+static uint *tuned_depth();
+
 #ifndef NDEBUG
 static int verify_heap(struct k_heap_t *self);
 #endif
@@ -55,6 +64,10 @@ void heap_init(struct k_heap_t *self, size_t capacity, uint depth) {
     self->depth = depth;
 }
 
+void heap_init(struct k_heap_t *self, size_t capacity) {
+    heap_init(self, capacity, heap_tuned_depth());
+}
+
 void heap_free(struct k_heap_t *self) {
     heap_assert (self);
 
@@ -90,7 +103,7 @@ void heap_extract_min(struct k_heap_t *self) {
 
     self->size--;
 
-    if (self->size > 1) {
+    if (self->size > 0) {
         heap_swap(self, 1, self->size+1);
         heap_sift_down(self, 1);
     }
@@ -103,6 +116,7 @@ void heapify_array (struct k_heap_t *self, long int *data, size_t size) {
 
     self->capacity = size+1;
     self->size = size;
+    self->depth = heap_tuned_depth();
 
     memcpy(self->data+1, data, size * sizeof(long int));
         for (ssize_t i = size; i > 0; --i) {
@@ -133,13 +147,15 @@ void heapify_array (struct k_heap_t *self, long int *data, size_t size) {
 //}
 
 static void heap_sift_up(struct k_heap_t *self, size_t indx) {
-    if (self->size == 1) {
+    if (indx == 1) {
         return;
     }
 
-    if (self->data[indx / self->depth] < self->data[indx]) {
-        heap_swap(self, indx / self->depth, indx);
-        heap_sift_up(self, indx / self->depth);
+    size_t parent = heap_parent(self, indx);
+
+    if (self->data[indx] < self->data[parent]) {
+        heap_swap(self, parent, indx);
+        heap_sift_up(self, parent);
     }
 }
 
@@ -175,6 +191,92 @@ static void heap_swap(struct k_heap_t *self, size_t left, size_t right) {
     self->data[right] = tmp;
 }
 
+// Inverse of the child range in heap_sift_down: children of i are (i-1)*depth+2 .. (i-1)*depth+depth+1
+static size_t heap_parent(struct k_heap_t *self, size_t indx) {
+    return (indx - 2) / self->depth + 1;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Host tuning
+// ---------------------------------------------------------------------------------------------------------------------
+
+const char *heap_tuning_path() {
+    const char *path = getenv("ALGO_TUNING");
+    return (path != NULL && path[0] != '\0') ? path : DEFAULT_TUNING_PATH;
+}
+
+uint heap_tuned_depth() {
+    return *tuned_depth();
+}
+
+void heap_set_tuned_depth(uint depth) {
+    *tuned_depth() = depth;
+}
+
+int heap_save_tuned_depth(const char *path) {
+    char *kept = NULL;
+    size_t kept_len = 0;
+    char line[TUNING_LINE_SIZE];
+    FILE *file = fopen(path, "r");
+
+    if (file != NULL) {
+        while (fgets(line, sizeof(line), file) != NULL) {
+            char key[64];
+
+            if (sscanf(line, "%63s", key) == 1 && strcmp(key, "heap_arity") == 0) {
+                continue;
+            }
+
+            size_t line_len = strlen(line);
+            kept = (char *) realloc(kept, kept_len + line_len);
+            memcpy(kept + kept_len, line, line_len);
+            kept_len += line_len;
+        }
+
+        fclose(file);
+    }
+
+    file = fopen(path, "w");
+
+    if (file == NULL) {
+        free(kept);
+        return 0;
+    }
+
+    fwrite(kept, 1, kept_len, file);
+    fprintf(file, "heap_arity %u\n", heap_tuned_depth());
+
+    free(kept);
+    return fclose(file) == 0;
+}
+
+static uint *tuned_depth() {
+    static uint depth = [] {
+        uint loaded = DEFAULT_HEAP_DEPTH;
+        FILE *file = fopen(heap_tuning_path(), "r");
+
+        if (file == NULL) {
+            return loaded;
+        }
+
+        char line[TUNING_LINE_SIZE];
+
+        while (fgets(line, sizeof(line), file) != NULL) {
+            char key[64];
+            unsigned long value;
+
+            if (sscanf(line, "%63s %lu", key, &value) == 2 && strcmp(key, "heap_arity") == 0 && value >= 2) {
+                loaded = (uint) value;
+            }
+        }
+
+        fclose(file);
+        return loaded;
+    }();
+
+    return &depth;
+}
+
 
 // ---------------------------------------------------------------------------------------------------------------------
 // debug section
@@ -190,8 +292,8 @@ if (!(cond)) {        \
 static int verify_heap(struct k_heap_t *self) {
     check (self->size <= self->capacity && "Broken size");
 
-    for (uint i = 2; i < self->size; ++i) {
-        check (self->data[i] > self->data[i/self->depth] && "Invalid order");
+    for (uint i = 2; i <= self->size; ++i) {
+        check (self->data[i] >= self->data[heap_parent(self, i)] && "Invalid order");
     }
 
     return 1;
@@ -14,6 +14,9 @@ struct k_heap_t {
 
 void heap_init(struct k_heap_t *self, size_t capacity, uint depth);
 
+// Arity from the host tuning, see heap_tuned_depth
+void heap_init(struct k_heap_t *self, size_t capacity);
+
 void heap_free(struct k_heap_t *self);
 
 void heap_insert(struct k_heap_t *self, long int val);
@@ -22,7 +25,22 @@ long int heap_get_min(struct k_heap_t *self);
 
 void heap_extract_min(struct k_heap_t *self);
 
+// Uses the tuned arity
 void heapify_array(struct k_heap_t *self, long int *data, size_t size);
 
+// ---------------------------------------------------------------------------------------------------------------------
+// Host tuning: heap_arity line of $ALGO_TUNING or ./tuning.cfg, shared with the Lab03 sort tuning
+// ---------------------------------------------------------------------------------------------------------------------
+
+const char *heap_tuning_path();
+
+// Read on first use, 2 if the file has no heap_arity
+uint heap_tuned_depth();
+
+void heap_set_tuned_depth(uint depth);
+
+// Rewrites the heap_arity line, other lines of the file are kept
+int heap_save_tuned_depth(const char *path);
+
 
 #endif //ALGO_K_HEAP_H
@@ -1,12 +1,16 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <time.h>
+#include <string.h>
 #include <sys/time.h>
 
 const int START_CAPACITY = 1024;
 
 #include "binheap.h"
 #include "fibheap.h"
+#include "k_heap.h"
+
+//#define TUNE
 
 // ---------------------------------------------------------------------------------------------------------------------
 // ---------------------------------------------------------------------------------------------------------------------
@@ -21,14 +25,20 @@ int *array_dup(int *array);
 
 void bench_binheap_sort ();
 void bench_fibheap_sort ();
+long bench_k_heap_sort (const long int *array, size_t len);
+void tune_heap_arity ();
 
 // ---------------------------------------------------------------------------------------------------------------------
 // ---------------------------------------------------------------------------------------------------------------------
 
 int main() {
     srand(time(NULL));
+#ifdef TUNE
+    tune_heap_arity();
+#else
     bench_binheap_sort();
 //    bench_fibheap_sort();
+#endif
 }
 
 // ---------------------------------------------------------------------------------------------------------------------
@@ -93,6 +103,69 @@ void bench_fibheap_sort () {
 }
 
 
+// ---------------------------------------------------------------------------------------------------------------------
+
+// Heap sort with the tuned arity, best of N_MEASURES in us
+long bench_k_heap_sort (const long int *array, size_t len) {
+    struct timeval start, stop;
+    long best_us = -1;
+
+    for (int n = 0; n < N_MEASURES; ++n) {
+        k_heap_t heap;
+        long int *arr = (long int *) malloc(len * sizeof (long int));
+        memcpy(arr, array, len * sizeof (long int));
+
+        gettimeofday(&start, NULL);
+
+        heapify_array(&heap, arr, len);
+
+        for (size_t i = 0; i < len; ++i) {
+            heap_extract_min(&heap);
+        }
+
+        gettimeofday(&stop, NULL);
+        long elapsed_us = (stop.tv_sec - start.tv_sec) * 1000000 + (stop.tv_usec - start.tv_usec);
+        best_us = (best_us < 0 || elapsed_us < best_us) ? elapsed_us : best_us;
+
+        heap_free(&heap);
+        free(arr);
+    }
+
+    return best_us;
+}
+
+// Picks the fastest k_heap_t depth for this host and writes it to the tuning file the library reads on startup
+void tune_heap_arity () {
+    const uint depths[] = {2, 3, 4, 6, 8, 16};
+    const size_t len = 1000000;
+    long int *array = gen_rand_array(len);
+    long best_us = -1;
+    uint best_depth = heap_tuned_depth();
+
+    for (uint depth : depths) {
+        heap_set_tuned_depth(depth);
+
+        long elapsed_us = bench_k_heap_sort(array, len);
+        printf ("K Heap #%u, %zu, %ld\n", depth, len, elapsed_us);
+        fflush(stdout);
+
+        if (best_us < 0 || elapsed_us < best_us) {
+            best_us = elapsed_us;
+            best_depth = depth;
+        }
+    }
+
+    free(array);
+    heap_set_tuned_depth(best_depth);
+
+    if (!heap_save_tuned_depth(heap_tuning_path())) {
+        fprintf (stderr, "Cannot write %s\n", heap_tuning_path());
+        return;
+    }
+
+    printf ("heap_arity %u written to %s\n", best_depth, heap_tuning_path());
+}
+
 // ---------------------------------------------------------------------------------------------------------------------
 
 long int *gen_rand_array(size_t len) {